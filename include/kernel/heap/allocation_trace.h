@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+enum class AllocationEvent : u8 {
+    Allocate,
+    Free,
+    // A block was resized in place. Moving reallocations show up as an Allocate and a Free.
+    Resize,
+    // A new heap region was committed. pointer is its base, size its size in bytes.
+    Grow,
+};
+
+/**
+ * One entry of the allocation trace. `chunks` is the number of bitmap chunks a block occupies, 0 for slab objects.
+ */
+struct AllocationRecord {
+    u64 timestamp;
+    usize pointer;
+    usize caller;
+    u32 size;
+    u32 chunks;
+    AllocationEvent event;
+};
+
+/**
+ * Fixed-size ring buffer of heap events, replacing per-allocation log output.
+ * Recording an event is a handful of stores, the oldest events are overwritten once the ring is full.
+ * The contents can be written out over the serial port in binary form with dump().
+ */
+class AllocationTrace final {
+public:
+    static constexpr usize CAPACITY = 2048;
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity has to be a power of two");
+
+    void record(AllocationEvent event, const void* pointer, usize size, usize chunks, const void* caller);
+
+    /**
+     * Writes the recorded events to the serial port, oldest first.
+     * The dump starts with the bytes "ATRC", followed by the record size, the number of records that follow
+     * and the total number of events recorded so far, each as a little-endian u32. The records are the raw
+     * AllocationRecord structures. Nothing is written if the serial port is not set up.
+     */
+    void dump() const;
+
+    void set_enabled(bool enabled) { m_enabled = enabled; }
+    [[nodiscard]] bool enabled() const { return m_enabled; }
+    // Total number of events recorded, including those that have since been overwritten.
+    [[nodiscard]] u32 recorded() const { return m_recorded; }
+    [[nodiscard]] usize size() const { return m_recorded < CAPACITY ? m_recorded : CAPACITY; }
+
+private:
+    AllocationRecord m_records[CAPACITY] {};
+    u32 m_recorded { 0 };
+    bool m_enabled { true };
+};
+
+}
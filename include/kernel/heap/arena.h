@@ -0,0 +1,146 @@
+#pragma once
+
+#include <libc/string.h>
+#include <stdlib/traits.h>
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+struct ArenaBlock;
+
+/**
+ * Linear allocator for objects that all die together.
+ * Memory is handed out by bumping a pointer through large blocks obtained from kmalloc, and given back all at once
+ * with reset() or rewind(). Blocks are kept around across resets, so an arena that is reused does not touch the heap
+ * again once it has grown to its working size. Individual deallocations are only honored for the most recent
+ * allocation, everything else is reclaimed by the next reset.
+ */
+class Arena final {
+public:
+    static constexpr usize DEFAULT_BLOCK_SIZE = 64 * KiB;
+    static constexpr usize DEFAULT_ALIGNMENT = 16;
+
+    /**
+     * Position in the arena, as returned by mark(). Rewinding to it frees everything allocated after mark() was called.
+     */
+    struct Marker {
+        ArenaBlock* block;
+        usize used;
+    };
+
+    /**
+     * @param block_size size of the blocks requested from the heap. Larger allocations get a block of their own.
+     */
+    explicit Arena(usize block_size = DEFAULT_BLOCK_SIZE)
+        : m_block_size(block_size) {
+    }
+    ~Arena() { release(); }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = delete;
+    Arena& operator=(Arena&&) = delete;
+
+    /**
+     * Allocates size bytes aligned to the given power of two.
+     * @return Pointer to uninitialized memory, valid until the arena is reset or rewound past it.
+     */
+    [[nodiscard]] void* allocate(usize size, usize alignment = DEFAULT_ALIGNMENT);
+    /**
+     * Gives back the memory at ptr if it was the most recent allocation, and does nothing otherwise.
+     */
+    void deallocate(void* ptr, usize size);
+    /**
+     * Grows or shrinks the most recent allocation in place.
+     * @return `true` if ptr now holds new_size bytes, `false` if it was not the most recent allocation or there is
+     * not enough room left in its block.
+     */
+    [[nodiscard]] bool try_resize(void* ptr, usize size, usize new_size);
+
+    [[nodiscard]] Marker mark() const;
+    /**
+     * Frees everything allocated since the marker was taken in O(1).
+     */
+    void rewind(Marker);
+    /**
+     * Frees everything in O(1). The blocks stay allocated and are reused.
+     */
+    void reset();
+    /**
+     * Frees everything and returns all blocks to the heap.
+     */
+    void release();
+
+    /**
+     * Returns the number of bytes obtained from the heap.
+     */
+    [[nodiscard]] usize capacity() const;
+
+private:
+    ArenaBlock* add_block(usize min_size);
+
+    // Blocks form a list in allocation order. Blocks after m_current are free and get reused as the arena fills up.
+    ArenaBlock* m_first { nullptr };
+    ArenaBlock* m_current { nullptr };
+    usize m_block_size;
+};
+
+/**
+ * Adaptor that lets the standard library containers allocate from an Arena, with the interface of allocator<T>.
+ * Containers have to be constructed with it explicitly, e.g. `Vector<int, ArenaAllocator<int>> v { ArenaAllocator<int>(arena) }`.
+ * Freeing the container's storage is a no-op unless it was the arena's most recent allocation,
+ * the memory comes back when the arena is reset.
+ * @tparam T type of the object to allocate
+ */
+template <typename T>
+class ArenaAllocator final {
+public:
+    using value_type = T;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = usize;
+    using difference_type = isize;
+    using propagate_on_container_move_assignment = true_type;
+
+    constexpr explicit ArenaAllocator(Arena& arena)
+        : m_arena(&arena) {
+    }
+    template <typename U>
+    constexpr ArenaAllocator(const ArenaAllocator<U>& other)
+        : m_arena(other.arena()) {
+    }
+
+    [[nodiscard]] pointer allocate(size_type n) {
+        static_assert(sizeof(value_type) != 0, "Cannot allocate an object of an incomplete type");
+        return static_cast<pointer>(m_arena->allocate(n * sizeof(value_type), alignment()));
+    }
+
+    void deallocate(pointer p, size_type n) { m_arena->deallocate(p, n * sizeof(value_type)); }
+
+    /**
+     * Resizes the storage at p, in place if it is the arena's most recent allocation. Same contract as allocator<T>::reallocate().
+     */
+    [[nodiscard]] pointer reallocate(pointer p, size_type n, size_type new_n) {
+        if (m_arena->try_resize(p, n * sizeof(value_type), new_n * sizeof(value_type)))
+            return p;
+
+        auto* new_p = allocate(new_n);
+        memcpy(new_p, p, (n < new_n ? n : new_n) * sizeof(value_type));
+        deallocate(p, n);
+        return new_p;
+    }
+
+    [[nodiscard]] Arena* arena() const { return m_arena; }
+
+    template <typename U>
+    [[nodiscard]] bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.arena(); }
+
+private:
+    static constexpr usize alignment() { return alignof(T) > Arena::DEFAULT_ALIGNMENT ? alignof(T) : Arena::DEFAULT_ALIGNMENT; }
+
+    Arena* m_arena;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdlib/optional.h>
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+/**
+ * Allocation bitmap with one bit per heap chunk (1 = allocated, 0 = free) and a hierarchy of summary levels on top.
+ * A bit on level n + 1 is set if the corresponding 32-bit word on level n is completely allocated,
+ * so one level 1 bit covers 32 chunks and one level 2 bit covers 1024 chunks. Searches use the summaries to
+ * skip fully used regions a word at a time, and scan the remaining words with bit-scan instructions.
+ * The storage for all levels is provided by the caller.
+ */
+class ChunkBitmap final {
+public:
+    static constexpr usize LEVELS = 3;
+    static constexpr usize BITS_PER_WORD = 32;
+
+    /**
+     * Returns the number of 32-bit words required to store the bitmap and its summaries for the given chunk count.
+     */
+    [[nodiscard]] static constexpr usize storage_words(usize chunks) {
+        usize words = 0;
+        for (usize level = 0; level < LEVELS; level++) {
+            chunks = (chunks + BITS_PER_WORD - 1) / BITS_PER_WORD;
+            words += chunks;
+        }
+        return words;
+    }
+
+    /**
+     * Sets up the bitmap on top of the given storage, with all chunks free.
+     * @param storage at least storage_words(chunks) words
+     * @param chunks number of chunks managed by this bitmap
+     */
+    void initialize(u32* storage, usize chunks);
+
+    /**
+     * Finds a run of free chunks, starting at the next-fit cursor and wrapping around once.
+     * @param count number of chunks the run has to contain
+     * @param alignment the first chunk of the run will be congruent to phase modulo this. Must be a power of two.
+     * @param phase see alignment, must be less than alignment
+     * @return Index of the first chunk of the run, or an empty Optional if no run is large enough.
+     */
+    [[nodiscard]] Optional<usize> find_free_run(usize count, usize alignment = 1, usize phase = 0) const;
+
+    /**
+     * Returns whether every chunk in [first, first + count) is free. The range may extend past the end of the bitmap,
+     * in which case the result is `false`.
+     */
+    [[nodiscard]] bool is_range_clear(usize first, usize count) const;
+
+    /**
+     * Marks a range of chunks as allocated and moves the next-fit cursor past it.
+     */
+    void set_range(usize first, usize count);
+    /**
+     * Marks a range of chunks as free, a word at a time.
+     */
+    void clear_range(usize first, usize count);
+
+    /**
+     * Calls callback(first, count) for every maximal run of free chunks, in ascending order.
+     * Fully allocated words are skipped using the summary levels.
+     */
+    template <typename Callback>
+    void for_each_free_run(Callback callback) const {
+        auto start = find_clear(0, 0);
+        while (start < m_chunks) {
+            const auto end = find_set(start, m_chunks);
+            callback(start, end - start);
+            start = find_clear(0, end);
+        }
+    }
+
+    [[nodiscard]] usize size() const { return m_chunks; }
+    /**
+     * Returns the given word of the bottom level, one bit per chunk.
+     */
+    [[nodiscard]] u32 word(usize index) const { return m_levels[0].words[index]; }
+
+private:
+    struct Level {
+        u32* words { nullptr };
+        usize bits { 0 };
+    };
+
+    [[nodiscard]] usize find_clear(usize level, usize index) const;
+    [[nodiscard]] usize find_set(usize index, usize limit) const;
+    [[nodiscard]] Optional<usize> find_free_run_in(usize count, usize alignment, usize phase, usize from, usize end) const;
+    void set_range_at(usize level, usize first, usize count);
+    void clear_range_at(usize level, usize first, usize count);
+
+    Level m_levels[LEVELS] {};
+    usize m_chunks { 0 };
+    usize m_next_fit { 0 };
+};
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <kernel/heap/chunk_bitmap.h>
+#include <stdlib/optional.h>
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+/**
+ * A contiguous, page-aligned piece of memory managed by the kernel heap.
+ * The region's own metadata (chunk bitmap, page map and dirty map) is stored at its start and sized from the region,
+ * the remaining pages are split into CHUNK_SIZE byte chunks.
+ * The dirty map tracks which free chunks are known to contain only zeroes, so zeroed allocations can skip clearing them.
+ */
+class HeapRegion final {
+public:
+    // The heap is split into chunks of this size.
+    static constexpr usize CHUNK_SIZE = 64;
+    static constexpr usize PAGE_SIZE = 4 * KiB;
+    static constexpr usize CHUNKS_PER_PAGE = PAGE_SIZE / CHUNK_SIZE;
+
+    /**
+     * Returns the number of bytes at the start of a region of the given size that are used for metadata.
+     * Always a multiple of PAGE_SIZE.
+     */
+    [[nodiscard]] static usize metadata_size(usize size);
+
+    /**
+     * Lays out the metadata at the start of [base, base + size) and marks every chunk as free.
+     * The previous contents of the region are unknown, so every chunk starts out dirty. The data area is not touched.
+     * @param base page-aligned start of the region
+     * @param size size of the region in bytes, a multiple of PAGE_SIZE
+     */
+    void initialize(usize base, usize size);
+
+    /**
+     * Finds and marks a run of free chunks.
+     * @param chunks number of chunks to allocate
+     * @param alignment byte alignment of the address `offset` bytes into the run. A power of two, at least CHUNK_SIZE.
+     * @param offset multiple of CHUNK_SIZE, see alignment
+     * @return Index of the first allocated chunk, or an empty Optional if the region has no large enough run.
+     */
+    [[nodiscard]] Optional<usize> allocate(usize chunks, usize alignment = CHUNK_SIZE, usize offset = 0);
+    /**
+     * Finds a run of free chunks like allocate(), but leaves the bitmap untouched.
+     * Only reads the region, so it can run without the heap lock. The result has to be claimed with try_allocate_at(),
+     * which fails if the run was taken in the meantime.
+     */
+    [[nodiscard]] Optional<usize> find(usize chunks, usize alignment = CHUNK_SIZE, usize offset = 0) const;
+    /**
+     * Marks the chunks [first_chunk, first_chunk + chunks) as allocated if all of them are free.
+     * Used to grow a block in place.
+     * @return `true` if the chunks were free and are now allocated, `false` if nothing was changed.
+     */
+    [[nodiscard]] bool try_allocate_at(usize first_chunk, usize chunks);
+    /**
+     * Marks the chunks as free. They are considered dirty until scrubbed or handed out zeroed again.
+     */
+    void free(usize first_chunk, usize chunks);
+
+    struct ChunkRange {
+        usize first_chunk;
+        usize chunks;
+    };
+
+    /**
+     * Marks the chunks in [first_chunk, first_chunk + chunks), which have to be allocated already, as clean without
+     * zeroing them. Only the dirty map is touched, so this is cheap enough to do under the heap lock, and the caller
+     * zeroes the returned range once the lock is released.
+     * @return The smallest range holding every chunk that was dirty, which may include clean chunks between them.
+     * Empty if all of them were clean already.
+     */
+    [[nodiscard]] ChunkRange take_dirty(usize first_chunk, usize chunks);
+    /**
+     * Clears up to max_chunks dirty free chunks, continuing where the previous call stopped.
+     * Meant to be called when there is nothing better to do, so later zeroed allocations find clean memory.
+     * @param max_words number of dirty map words to look at before giving up, at most scrub_words() are useful
+     * @return Number of chunks that were cleared.
+     */
+    usize scrub(usize max_chunks, usize max_words);
+    /**
+     * Returns the number of dirty map words, each covering BITS_PER_WORD chunks.
+     */
+    [[nodiscard]] usize scrub_words() const { return dirty_map_words(m_chunks); }
+
+    /**
+     * Calls callback(first_chunk, chunks) for every run of free chunks in the region.
+     */
+    template <typename Callback>
+    void for_each_free_run(Callback callback) const { m_bitmap.for_each_free_run(callback); }
+
+    [[nodiscard]] bool contains(const void*) const;
+    [[nodiscard]] bool is_initialized() const { return m_size != 0; }
+
+    [[nodiscard]] u8* chunk_address(usize chunk) const { return reinterpret_cast<u8*>(m_data_start + chunk * CHUNK_SIZE); }
+    [[nodiscard]] usize chunk_index(const void* ptr) const { return (reinterpret_cast<usize>(ptr) - m_data_start) / CHUNK_SIZE; }
+    [[nodiscard]] usize page_index(const void* ptr) const { return (reinterpret_cast<usize>(ptr) - m_data_start) / PAGE_SIZE; }
+
+    /**
+     * Per-page owner byte, used by the MemoryManager to tell slab spans and bitmap blocks apart.
+     */
+    [[nodiscard]] u8 page_owner(usize page) const { return m_page_map[page]; }
+    void set_page_owner(usize page, u8 owner) { m_page_map[page] = owner; }
+
+    [[nodiscard]] usize base() const { return m_base; }
+    [[nodiscard]] usize size() const { return m_size; }
+    [[nodiscard]] usize data_start() const { return m_data_start; }
+    [[nodiscard]] usize data_size() const { return m_chunks * CHUNK_SIZE; }
+    [[nodiscard]] usize free_chunks() const { return m_free_chunks; }
+
+private:
+    [[nodiscard]] static constexpr usize dirty_map_words(usize chunks) { return (chunks + ChunkBitmap::BITS_PER_WORD - 1) / ChunkBitmap::BITS_PER_WORD; }
+    void set_dirty(usize first_chunk, usize chunks);
+    // Zeroes the dirty chunks selected by mask in the given dirty map word and marks them clean.
+    usize clear_dirty(usize word, u32 mask);
+
+    ChunkBitmap m_bitmap;
+    u8* m_page_map { nullptr };
+    // One bit per chunk, set if a free chunk may contain anything other than zeroes. Meaningless for allocated chunks.
+    u32* m_dirty_map { nullptr };
+    // Word of the dirty map where the next scrub() starts.
+    usize m_scrub_cursor { 0 };
+    usize m_base { 0 };
+    usize m_size { 0 };
+    usize m_data_start { 0 };
+    usize m_chunks { 0 };
+    usize m_free_chunks { 0 };
+};
+
+}
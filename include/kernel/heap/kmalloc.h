@@ -1,33 +1,170 @@
 #pragma once
 
+#include <kernel/heap/allocation_trace.h>
+#include <kernel/heap/heap_region.h>
+#include <kernel/heap/large_allocation_table.h>
+#include <kernel/heap/memory_map.h>
+#include <kernel/heap/page_allocator.h>
+#include <kernel/heap/slab.h>
+#include <kernel/util/spinlock.h>
 #include <stdlib/types.h>
 
 void* kmalloc(usize);
+void* kzalloc(usize);
+void* kmalloc_aligned(usize, usize);
+void* krealloc(void*, usize);
 void kfree(void*);
+void kfree_sized(void*, usize);
 
 void* operator new(usize);
 void operator delete(void*);
 void operator delete(void*, usize);
 
+// Placement new, as there is no <new> to provide it.
+inline void* operator new(usize, void* ptr) noexcept { return ptr; }
+
 namespace Kernel {
 
+/**
+ * Snapshot of the heap's occupancy and fragmentation, see MemoryManager::stats().
+ */
+struct HeapStats {
+    static constexpr usize BUCKETS = 32;
+
+    usize regions;
+    // Bytes in committed regions, excluding their metadata.
+    usize committed;
+    // Bytes still free in the page allocator, not committed to any region.
+    usize reserve;
+    usize free;
+    usize largest_free_run;
+    // Bucket n counts the free runs of [2^n, 2^(n + 1)) chunks.
+    usize free_runs[BUCKETS];
+    // Bucket n counts the live allocations of (2^(n - 1), 2^n] bytes. Bucket 4 also holds everything smaller.
+    usize live_allocations[BUCKETS];
+
+    // Chunks occupied by live bitmap blocks, and how much of that was actually requested.
+    // The difference is lost to the block headers and rounding up to whole chunks.
+    usize block_bytes;
+    usize block_requested;
+    // Pages held by slab spans, and how much of that is taken up by live objects.
+    usize slab_span_bytes;
+    usize slab_object_bytes;
+    // Allocations served directly from the page allocator, and the pages they occupy.
+    usize large_allocations;
+    usize large_bytes;
+    // Longest time the heap lock was held, and interrupts disabled, in TSC cycles. Zeroing memory never counts
+    // towards it, only bitmap and dirty map updates and bounded scrub steps do.
+    u64 max_irq_off_cycles;
+
+    [[nodiscard]] usize internal_fragmentation() const { return block_bytes - block_requested; }
+    /**
+     * Returns the share of free memory, in percent, that is not part of the largest free run.
+     * High values mean large allocations can fail even though enough memory is free.
+     */
+    [[nodiscard]] usize external_fragmentation() const { return free ? 100 - largest_free_run * 100 / free : 0; }
+
+    void print() const;
+};
+
+/**
+ * The kernel heap. All state is protected by a spinlock that keeps interrupts disabled while held, so it is only taken
+ * for short critical sections: bitmap searches run with interrupts enabled, and only claiming the run that was found,
+ * freeing, and updating the bookkeeping happen under the lock. Memory handed out zeroed is cleared after the lock is
+ * released, so no critical section grows with the size of an allocation.
+ */
 class MemoryManager final {
 public:
-    static MemoryManager& get() {
-        static MemoryManager instance;
-        return instance;
-    }
+    static constexpr usize PAGE_SIZE = HeapRegion::PAGE_SIZE;
+    static constexpr usize MAX_REGIONS = 16;
+    // Granularity of the address to region lookup table.
+    static constexpr usize REGION_GRANULE = 4 * MiB;
+    // Allocations larger than this bypass the regions and get a page run of their own.
+    static constexpr usize LARGE_ALLOCATION_THRESHOLD = 16 * KiB;
+
+    static MemoryManager& get() { return s_instance; }
 
     MemoryManager(const MemoryManager&) = delete;
     MemoryManager& operator=(const MemoryManager&) = delete;
     MemoryManager(MemoryManager&&) = delete;
     MemoryManager& operator=(MemoryManager&&) = delete;
 
-    void initialize(u64, u64);
+    /**
+     * Hands the given physical memory to the page allocator, which the heap commits its regions from.
+     * The map should only contain usable memory, with the kernel image and anything else still in use already
+     * reserved, and be trimmed to whole pages.
+     * Only a small initial region is set up right away, the rest is committed as further regions on demand.
+     */
+    void initialize(const MemoryMap&);
+    /**
+     * Allocates a block of uninitialized memory.
+     * Blocks above LARGE_ALLOCATION_THRESHOLD are page runs from the page allocator, so they are page aligned and
+     * don't take up room in the regions.
+     */
     void* allocate(usize);
-    void* allocate_aligned(usize, usize);
+    /**
+     * Allocates a block that is filled with zeroes.
+     * Chunks that have not been used since they were last cleared are not written to again.
+     */
+    void* allocate_zeroed(usize);
+    /**
+     * Allocates a block whose address is a multiple of the given alignment.
+     * The heap searches for a run of chunks that ends up aligned instead of over-allocating,
+     * so the block costs at most one extra chunk. Freed with free(), like any other block.
+     * @param size size in bytes
+     * @param alignment a power of two
+     */
+    void* allocate_aligned(usize size, usize alignment);
+    /**
+     * Resizes a block, in place if possible, and moves it to a new block otherwise.
+     * The contents are preserved up to the lesser of the old and new sizes.
+     * @param ptr pointer returned by allocate(), or `nullptr` to allocate a new block
+     * @param size new size in bytes
+     * Like allocate(), this never returns `nullptr`, running out of memory is fatal.
+     * @return Pointer to the resized block, which might be ptr itself.
+     */
+    void* reallocate(void* ptr, usize size);
+    /**
+     * Grows or shrinks a block without moving it.
+     * Blocks from the bitmap heap grow into the chunks directly behind them if those are free,
+     * and give their trailing chunks back when shrinking. Slab objects can only be resized within their size class,
+     * and large allocations only within their last page, or by giving trailing pages back.
+     * @return `true` if the block now holds at least size bytes, `false` if it was left untouched.
+     */
+    [[nodiscard]] bool try_expand(void* ptr, usize size);
+    /**
+     * Returns the number of bytes that can be used at ptr, which may be more than was originally requested.
+     */
+    [[nodiscard]] usize usable_size(const void* ptr);
     void free(void*);
-    void free_aligned(void*);
+    /**
+     * Frees a block whose size is known to the caller, as used by sized operator delete.
+     * Small objects carry no header either way, the size is checked against the object's span.
+     * @param size the size the block was allocated or last resized with
+     */
+    void free(void*, usize size);
+
+    /**
+     * Zeroes up to max_bytes of free heap memory in the background, so later zeroed allocations don't have to.
+     * Each call continues where the previous one stopped. Meant to be called while the kernel is idle.
+     * @return Number of bytes that were cleared.
+     */
+    usize scrub(usize max_bytes);
+
+    /**
+     * Returns the ring of recent heap events. Use dump() on it to get them out over the serial port.
+     */
+    [[nodiscard]] AllocationTrace& trace() { return m_trace; }
+    /**
+     * Returns the allocator for physical page frames that backs the heap.
+     */
+    [[nodiscard]] PageAllocator& pages() { return m_pages; }
+
+    /**
+     * Collects the current heap statistics. The allocation figures are kept up to date as blocks come and go,
+     * only the free run figures are gathered by walking the chunk bitmaps of all regions, one region at a time.
+     */
+    [[nodiscard]] HeapStats stats();
 
     [[nodiscard]] u64 allocations() const;
     [[nodiscard]] u64 frees() const;
@@ -36,18 +173,79 @@ public:
     [[nodiscard]] u64 total() const;
 
 private:
-    u64 m_memory_start;
-    u64 m_memory_size;
-    u64 m_allocation_count;
-    u64 m_allocated;
-    u64 m_free_count;
-    u64 m_free;
+    friend class SlabAllocator;
+
+    // Owns all physical memory, heap regions are allocated from it as page runs.
+    PageAllocator m_pages;
+    u64 m_memory_size { 0 };
+    u64 m_committed { 0 };
+    u64 m_allocation_count { 0 };
+    u64 m_allocated { 0 };
+    u64 m_free_count { 0 };
+    u64 m_free { 0 };
+
+    // Incrementally maintained parts of HeapStats.
+    usize m_live_allocations[HeapStats::BUCKETS] {};
+    usize m_block_bytes { 0 };
+    usize m_block_requested { 0 };
+    usize m_slab_span_bytes { 0 };
+    usize m_slab_object_bytes { 0 };
+    usize m_large_bytes { 0 };
+
+    bool m_initialized { false };
 
-    bool m_initialized;
+    Spinlock m_lock;
+    // Bumped under the lock whenever a chunk bitmap changes, see allocate_chunks().
+    usize m_generation { 0 };
+
+    struct ChunkRun {
+        HeapRegion* region;
+        usize first_chunk;
+    };
+
+    HeapRegion m_regions[MAX_REGIONS] {};
+    usize m_region_count { 0 };
+
+    // Region indices sorted by address, and for every REGION_GRANULE of the 32-bit address space, the position in
+    // that order of the first region overlapping it. Regions in the same granule follow it in the order.
+    static constexpr usize REGION_LOOKUP_SIZE = (static_cast<u64>(1) << 32) / REGION_GRANULE;
+    static constexpr u8 NO_REGION = 0xff;
+    u8 m_region_order[MAX_REGIONS] {};
+    u8 m_region_lookup[REGION_LOOKUP_SIZE] {};
+    SlabAllocator m_slab;
+    LargeAllocationTable m_large;
+    AllocationTrace m_trace;
 
     bool is_kmalloc_address(const void*);
+    HeapRegion* region_for(const void*);
+    HeapRegion* grow(usize min_size);
+    /**
+     * Finds and claims a run of chunks, growing the heap if necessary. Must be called without holding the lock.
+     * commit(region, first_chunk) is called with the lock held right after the run is claimed.
+     */
+    template <typename Commit>
+    ChunkRun allocate_chunks(usize chunks, usize alignment, usize offset, Commit commit);
+    void register_region(usize index);
+    static SlabSpan* slab_span_for(const HeapRegion&, const void*);
+    // The private variants take the address the heap was called from, for the allocation trace.
+    void* allocate_block(usize, bool zeroed, const void* caller);
+    void* allocate_bitmap(usize, bool zeroed, const void* caller);
+    bool expand(void*, usize, const void* caller);
+    void free_block(void*, usize size, const void* caller);
+    void free_bitmap(HeapRegion&, void*, const void* caller);
+    void* allocate_large(usize, bool zeroed, const void* caller);
+    bool expand_large(LargeAllocation&, usize, const void* caller);
+    void free_large(void*, usize size, const void* caller);
+    void count_block(usize size, usize chunks);
+    void uncount_block(usize size, usize chunks);
+    // Page runs for slab spans. allocate_pages() takes the lock itself, free_pages() expects it to be held.
+    void* allocate_pages(usize);
+    void free_pages(void*, usize);
+
+    constexpr MemoryManager() = default;
 
-    MemoryManager() = default;
+    // Constant-initialized, so it is usable before anything runs and needs no guard on every allocation.
+    static MemoryManager s_instance;
 };
 
 }
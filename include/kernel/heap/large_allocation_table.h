@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+/**
+ * A large allocation, served directly from the page allocator as a run of whole pages.
+ */
+struct LargeAllocation {
+    // Address of the first page, which is also the pointer handed out. 0 marks an unused table slot.
+    usize address;
+    usize pages;
+    // Requested size, for the heap statistics.
+    usize size;
+};
+
+/**
+ * Fixed-size hash table of the live large allocations, keyed by address.
+ * Large allocations carry no header, so this is where free() finds out how many pages to give back.
+ * Uses open addressing with linear probing, and is never filled beyond 3/4 of its capacity to keep probe sequences short.
+ */
+class LargeAllocationTable final {
+public:
+    // Must be a power of two.
+    static constexpr usize CAPACITY = 256;
+    static constexpr usize MAX_ENTRIES = CAPACITY / 4 * 3;
+
+    void clear();
+
+    /**
+     * Adds an allocation to the table.
+     * @return `false` if the table is full, in which case nothing was added.
+     */
+    [[nodiscard]] bool insert(const LargeAllocation&);
+    /**
+     * Returns the entry of the allocation starting at ptr, or `nullptr` if ptr is not a large allocation.
+     */
+    [[nodiscard]] LargeAllocation* find(const void* ptr);
+    /**
+     * Removes an entry previously returned by find().
+     */
+    void remove(LargeAllocation*);
+
+    [[nodiscard]] usize count() const { return m_count; }
+    [[nodiscard]] bool is_full() const { return m_count == MAX_ENTRIES; }
+
+private:
+    [[nodiscard]] static usize slot_for(usize address);
+
+    LargeAllocation m_entries[CAPACITY] {};
+    usize m_count { 0 };
+};
+
+}
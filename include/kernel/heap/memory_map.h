@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdlib/optional.h>
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+struct MemoryRange {
+    u64 start;
+    u64 size;
+
+    [[nodiscard]] u64 end() const { return start + size; }
+};
+
+/**
+ * Sorted list of non-overlapping physical memory ranges, built from the bootloader's memory map.
+ * Adjacent and overlapping ranges are merged as they are added, and reserved areas are cut out again,
+ * splitting ranges where necessary.
+ */
+class MemoryMap final {
+public:
+    static constexpr usize MAX_RANGES = 32;
+
+    /**
+     * Adds [start, start + size) to the map, merging it with any ranges it overlaps or touches.
+     */
+    void add(u64 start, u64 size);
+    /**
+     * Removes [start, start + size) from the map. Parts of it that are not in the map are ignored.
+     */
+    void reserve(u64 start, u64 size);
+    /**
+     * Shrinks every range to whole pages and drops everything at or above limit.
+     */
+    void trim(u64 limit, usize page_size);
+
+    /**
+     * Removes and returns a range from the start of the first range that holds preferred_size bytes.
+     * If no range is that large, takes as much as possible from the largest range instead.
+     * @return The range that was taken, or an empty Optional if no range holds at least min_size bytes.
+     */
+    [[nodiscard]] Optional<MemoryRange> take(u64 min_size, u64 preferred_size);
+
+    [[nodiscard]] usize count() const { return m_count; }
+    [[nodiscard]] const MemoryRange& range(usize index) const { return m_ranges[index]; }
+
+private:
+    void insert_at(usize index, MemoryRange);
+    void remove_at(usize index);
+
+    MemoryRange m_ranges[MAX_RANGES] {};
+    usize m_count { 0 };
+};
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <kernel/heap/memory_map.h>
+#include <kernel/util/spinlock.h>
+#include <stdlib/optional.h>
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+struct FreePageBlock;
+
+/**
+ * Buddy allocator for physical page frames.
+ * Free memory is kept as blocks of 2^order pages, each aligned to its own size, on one free list per order.
+ * Allocating splits a larger block down to the requested order, freeing merges a block with its buddy (the other
+ * half of the block they were split from) for as long as the buddy is free too, so both take O(MAX_ORDER) steps.
+ * A frame table with one byte per page frame records the order of every free block, and the free list links are
+ * stored in the free pages themselves.
+ */
+class PageAllocator final {
+public:
+    static constexpr usize PAGE_SIZE = 4 * KiB;
+    // The largest blocks are 2^MAX_ORDER pages, 4 MiB.
+    static constexpr usize MAX_ORDER = 10;
+    static constexpr usize ORDER_COUNT = MAX_ORDER + 1;
+
+    struct Stats {
+        usize total_pages;
+        usize free_pages;
+        // Number of free blocks, and number of allocations served so far, per order.
+        usize free_blocks[ORDER_COUNT];
+        usize allocations[ORDER_COUNT];
+        usize splits;
+        usize merges;
+        // Longest time the lock was held, and interrupts disabled, in TSC cycles.
+        u64 max_irq_off_cycles;
+
+        void print() const;
+    };
+
+    /**
+     * Takes over every page in the map. The frame table is carved out of the map first, the rest becomes free blocks.
+     * The map has to be trimmed to whole pages.
+     */
+    void initialize(const MemoryMap&);
+
+    /**
+     * Allocates a block of 2^order pages, aligned to its size.
+     * @return Physical address of the block, or an empty Optional if no large enough block is free.
+     */
+    [[nodiscard]] Optional<usize> allocate(usize order);
+    /**
+     * Returns a block obtained from allocate() with the same order.
+     */
+    void free(usize address, usize order);
+
+    /**
+     * Allocates count contiguous pages. The run starts on a block of the smallest order that fits,
+     * and the pages beyond count are freed again right away. Runs larger than the largest block are made up of
+     * adjacent free blocks of MAX_ORDER, which takes a walk over that free list.
+     * @return Physical address of the first page, or an empty Optional if no large enough run is free.
+     */
+    [[nodiscard]] Optional<usize> allocate_pages(usize count);
+    /**
+     * Frees count pages starting at address. Any page range that was allocated can be freed, in any number of pieces.
+     */
+    void free_pages(usize address, usize count);
+
+    /**
+     * Returns the smallest order whose blocks hold at least the given number of pages.
+     */
+    [[nodiscard]] static usize order_for(usize pages);
+
+    [[nodiscard]] Stats stats() const;
+    [[nodiscard]] usize free_page_count() const { return m_free_pages; }
+    [[nodiscard]] usize total_pages() const { return m_total_pages; }
+
+private:
+    // Everything below works on page frame numbers (address / PAGE_SIZE), which cannot overflow when adding block sizes.
+    Optional<usize> take_block(usize order);
+    Optional<usize> take_contiguous(usize blocks);
+    void release(usize frame, usize order);
+    void release_range(usize frame, usize count);
+    void push(usize frame, usize order);
+    void unlink(usize frame, usize order);
+    [[nodiscard]] bool is_free_block(usize frame, usize order) const;
+
+    mutable Spinlock m_lock;
+    FreePageBlock* m_free_lists[ORDER_COUNT] {};
+    // Indexed by frame - m_first_frame. order + 1 for the first frame of a free block, 0 for every other frame.
+    u8* m_frame_orders { nullptr };
+    usize m_first_frame { 0 };
+    usize m_frame_count { 0 };
+
+    usize m_total_pages { 0 };
+    usize m_free_pages { 0 };
+    usize m_free_blocks[ORDER_COUNT] {};
+    usize m_allocations[ORDER_COUNT] {};
+    usize m_splits { 0 };
+    usize m_merges { 0 };
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+struct SlabSpan;
+
+/**
+ * Size-class allocator for small objects, sitting in front of the bitmap heap.
+ * Objects of the same size class are carved out of page-sized spans, so allocating and freeing them is O(1)
+ * regardless of how full the heap is. Spans themselves are requested from (and returned to) the MemoryManager.
+ * Not synchronized, the MemoryManager calls it with its lock held.
+ */
+class SlabAllocator final {
+public:
+    static constexpr usize MIN_SIZE = 16;
+    static constexpr usize MAX_SIZE = 2048;
+    // 16, 32, 64, 128, 256, 512, 1024, 2048
+    static constexpr usize CLASS_COUNT = 8;
+
+    /**
+     * Allocates an object from the smallest size class that fits.
+     * @param size requested size in bytes, must not exceed MAX_SIZE
+     * @return Pointer to the object, or `nullptr` if the size class has no span with room left. In that case,
+     * hand it a new span with add_span() and try again.
+     */
+    void* allocate(usize size);
+    /**
+     * Sets up a new span for the size class that serves the given size.
+     * @param memory span_pages(size) pages from the MemoryManager
+     */
+    void add_span(usize size, void* memory);
+    /**
+     * Returns an object to the span it was allocated from.
+     * @param span the span containing the object, as reported by the MemoryManager's page map
+     * @param ptr pointer previously returned by allocate()
+     */
+    void free(SlabSpan* span, void* ptr);
+
+    /**
+     * Returns the size of the objects stored in the given span.
+     */
+    [[nodiscard]] static usize object_size(const SlabSpan*);
+    /**
+     * Returns the size of the objects an allocation of the given size is served from.
+     */
+    [[nodiscard]] static usize object_size_for(usize size) { return class_size(size_class_for(size)); }
+    /**
+     * Returns the number of pages in a span of the size class that serves the given size.
+     */
+    [[nodiscard]] static usize span_pages(usize size) { return span_pages_for(size_class_for(size)); }
+
+    [[nodiscard]] static constexpr bool handles(usize size) { return size <= MAX_SIZE; }
+    [[nodiscard]] static usize class_size(usize size_class) { return MIN_SIZE << size_class; }
+
+private:
+    struct SizeClass {
+        // Spans with at least one free object.
+        SlabSpan* partial { nullptr };
+        // A single completely free span kept around to avoid thrashing the bitmap heap.
+        SlabSpan* spare { nullptr };
+    };
+
+    static usize size_class_for(usize size);
+    static usize span_pages_for(usize size_class);
+
+    static SlabSpan* create_span(usize size_class, u8* memory);
+    void unlink(SizeClass&, SlabSpan*);
+    void push_front(SizeClass&, SlabSpan*);
+
+    SizeClass m_classes[CLASS_COUNT] {};
+};
+
+}
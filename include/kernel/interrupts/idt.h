@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+/**
+ * What the CPU pushes when it interrupts ring 0 code.
+ */
+struct InterruptFrame {
+    usize eip;
+    usize cs;
+    usize eflags;
+};
+
+/**
+ * Interrupt handlers have to be declared INTERRUPT_HANDLER, so the compiler saves every register and returns with
+ * iret. They may only touch general purpose registers, as nobody saves the FPU and SSE state around them.
+ */
+#define INTERRUPT_HANDLER [[gnu::interrupt, gnu::target("general-regs-only")]]
+
+using InterruptHandler = void (*)(InterruptFrame*);
+
+/**
+ * The interrupt descriptor table, with an interrupt gate for every vector.
+ * CPU exceptions panic with their name and the faulting address. Other vectors return right away until a handler is
+ * installed for them, which covers spurious interrupts from the PIC.
+ */
+class IDT final {
+public:
+    static constexpr usize ENTRIES = 256;
+    static constexpr u8 EXCEPTION_COUNT = 32;
+
+    static IDT& get() { return s_instance; }
+
+    IDT(const IDT&) = delete;
+    IDT& operator=(const IDT&) = delete;
+    IDT(IDT&&) = delete;
+    IDT& operator=(IDT&&) = delete;
+
+    /**
+     * Fills in every gate and loads the table. Interrupts stay disabled.
+     */
+    void initialize();
+    /**
+     * Routes a vector to handler. Interrupts are disabled while the handler runs.
+     */
+    void set_handler(u8 vector, InterruptHandler handler);
+
+private:
+    constexpr IDT() = default;
+
+    static IDT s_instance;
+
+    struct [[gnu::packed]] Gate {
+        u16 offset_low;
+        u16 selector;
+        u8 zero;
+        u8 type_attributes;
+        u16 offset_high;
+    };
+
+    void set_gate(u8 vector, usize address);
+
+    Gate m_gates[ENTRIES] {};
+    u16 m_code_selector { 0 };
+};
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel::PIC {
+
+// IRQs 0-15 are delivered on these vectors after remap(), clear of the CPU exceptions.
+static constexpr u8 IRQ_BASE = 0x20;
+
+/**
+ * Initializes both 8259 PICs, moving IRQs 0-15 to IRQ_BASE onwards, and masks every IRQ.
+ */
+void remap();
+
+void mask(u8 irq);
+void unmask(u8 irq);
+
+/**
+ * Acknowledges an IRQ. Has to be sent before the handler returns, or the PIC holds back every IRQ of the same or lower
+ * priority.
+ */
+void end_of_interrupt(u8 irq);
+
+}
@@ -6,6 +6,9 @@ namespace Kernel {
 
 class PIT final {
 public:
+    // Input clock of every channel, in Hz. Counts divide it down to the output frequency.
+    static constexpr u32 OSCILLATOR_FREQUENCY = 1193182;
+
     PIT() = default;
 
     enum class Channel : u8 {
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <kernel/util/spinlock.h>
+#include <stdlib/optional.h>
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+class CPUID;
+
+/**
+ * Attributes of a mapping, with the values of the corresponding bits in x86 page directory and page table entries.
+ * Mappings are always present and readable.
+ */
+enum class PageFlags : u32 {
+    None = 0,
+    Writable = (1 << 1),
+    User = (1 << 2),
+    WriteThrough = (1 << 3),
+    CacheDisable = (1 << 4),
+    // Kept in the TLB across CR3 switches. Only takes effect if the CPU supports PGE.
+    Global = (1 << 8),
+    // Write-combining memory type, for framebuffers and the like. Only takes effect if the CPU supports PAT.
+    // Bit 9 is free for software use; it is translated to the PAT entry set up for write-combining.
+    WriteCombining = (1 << 9),
+};
+
+constexpr PageFlags operator|(PageFlags a, PageFlags b) {
+    return static_cast<PageFlags>(static_cast<u32>(a) | static_cast<u32>(b));
+}
+
+/**
+ * A 32-bit, two-level x86 page directory, mapping the address space with 4 KiB pages through page tables,
+ * or with 4 MiB pages directly from the directory where the CPU supports PSE.
+ * The kernel directory identity maps physical memory, so page tables allocated from the page allocator
+ * can be written to through their physical address.
+ */
+class PageDirectory final {
+public:
+    static constexpr usize PAGE_SIZE = 4 * KiB;
+    static constexpr usize LARGE_PAGE_SIZE = 4 * MiB;
+    static constexpr usize ENTRIES = 1024;
+
+    static PageDirectory& kernel() { return s_kernel; }
+
+    PageDirectory(const PageDirectory&) = delete;
+    PageDirectory& operator=(const PageDirectory&) = delete;
+    PageDirectory(PageDirectory&&) = delete;
+    PageDirectory& operator=(PageDirectory&&) = delete;
+
+    /**
+     * Sets up the kernel directory and turns paging on. [0, identity_limit) is identity mapped writable and global,
+     * with 4 MiB pages if the CPU supports PSE and 4 KiB pages otherwise. Page 0 is left unmapped to catch null
+     * pointer accesses, which puts the first 4 MiB in a page table. Needs the page allocator to be up.
+     * With PAT, one of its entries is switched to write-combining for PageFlags::WriteCombining.
+     */
+    void initialize(CPUID&, u64 identity_limit);
+
+    /**
+     * Maps the 4 KiB page at virtual_address to physical_address, replacing any previous mapping.
+     * A 4 MiB page covering the address is split into a page table first, keeping the rest of it mapped as before.
+     */
+    void map_page(usize virtual_address, usize physical_address, PageFlags);
+    /**
+     * Maps the 4 MiB page at virtual_address to physical_address, replacing any previous mappings in that range.
+     * Both addresses have to be 4 MiB aligned, and the CPU has to support PSE.
+     */
+    void map_large_page(usize virtual_address, usize physical_address, PageFlags);
+    void unmap_page(usize virtual_address);
+    void unmap_large_page(usize virtual_address);
+    /**
+     * Maps [address, address + size) to itself, with 4 MiB pages wherever the range and the CPU allow.
+     */
+    void identity_map(usize address, u64 size, PageFlags);
+
+    /**
+     * Walks the directory to translate a virtual address.
+     * @return The physical address, or an empty Optional if the address is not mapped.
+     */
+    [[nodiscard]] Optional<usize> physical_address(usize virtual_address) const;
+
+    [[nodiscard]] bool supports_large_pages() const { return m_large_pages; }
+    [[nodiscard]] bool supports_global_pages() const { return m_global_pages; }
+    [[nodiscard]] bool supports_write_combining() const { return m_write_combining; }
+
+private:
+    constexpr PageDirectory() = default;
+
+    static PageDirectory s_kernel;
+
+    // Returns the page table covering the address, creating it or splitting a 4 MiB page into it as needed.
+    u32* table_for(usize virtual_address);
+    u32 entry_flags(PageFlags, bool large) const;
+    void free_table(u32 directory_entry);
+    void flush(usize virtual_address);
+    void flush_all();
+
+    u32* m_entries { nullptr };
+    bool m_large_pages { false };
+    bool m_global_pages { false };
+    bool m_write_combining { false };
+    Spinlock m_lock;
+};
+
+}
@@ -4,7 +4,7 @@
 
 namespace Kernel {
 
-enum class CPUIDRequest {
+enum class CPUIDRequest : u32 {
     GET_VENDOR_STRING = 0x00, // Highest Function Parameter and Manufacturer ID
     GET_FEATURES = 0x01, // Processor Info and Feature Bits
     GET_TLB_INFO = 0x02, // Cache and TLB Descriptor information
@@ -12,6 +12,8 @@ enum class CPUIDRequest {
     GET_INTEL_TOPOLOGY = 0x04, // Intel thread/core and cache topology
     GET_THERMAL_POWER_MGMT = 0x06, // Thermal and power management
     GET_EXTENDED_FEATURES = 0x07, // Extended Features
+    GET_HIGHEST_EXTENDED_FUNCTION = 0x80000000, // Highest Extended Function Implemented
+    GET_ADDRESS_SIZES = 0x80000008, // Virtual and Physical address Sizes
 };
 
 enum class CPUFeature {
@@ -106,6 +108,8 @@ public:
     StringView vendor();
     bool has_feature(CPUFeature);
     ProcessorInfo info();
+    // Width of physical addresses, as needed for MTRR masks. Falls back to 36 bits with PAE or PSE-36, 32 without.
+    u32 physical_address_bits();
 
 private:
     u32 m_eax, m_ebx, m_ecx, m_edx;
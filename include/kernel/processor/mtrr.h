@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel::MTRR {
+
+/**
+ * Marks [base, base + size) write-combining with a free variable-range MTRR, for CPUs without PAT.
+ * Variable ranges are powers of two aligned to their size, so the range is rounded up to the next power of two,
+ * which base has to be aligned to.
+ * @return false if the CPU lacks MTRRs or their write-combining type, the range can't be covered, no variable range
+ *         is free, or an existing range of another type overlaps it (the SDM leaves most overlaps undefined).
+ */
+bool set_write_combining(u64 base, u64 size);
+
+}
@@ -1,10 +1,27 @@
 #pragma once
 
+#include <stdlib/types.h>
+
 namespace Kernel {
 
+class CPUID;
+
 class Processor final {
 public:
+    /**
+     * Turns on the x87 FPU, and SSE where CPUID reports both SSE and FXSAVE/FXRSTOR, which the OS has to declare
+     * support for before SSE instructions stop faulting. Pass `false` for use_sse to keep the scalar fallbacks,
+     * for comparison or for broken emulators.
+     */
+    static void initialize(CPUID&, bool use_sse);
+
+    /**
+     * Whether SSE2 instructions can be used. Code using them must check this and provide a scalar path.
+     */
+    [[nodiscard]] static bool has_sse2() { return s_sse2; }
+
 private:
+    static inline bool s_sse2 { false };
 };
 
 }
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel::Time {
+
+class Timer;
+
+/**
+ * Paces presentation to a fixed frame rate. Frame n is due n / fps seconds after start(), measured in timer ticks.
+ * Waiting for a frame to become due goes through Timer::wait_until(), so the timer's idle hook gets the slack.
+ * A caller that falls behind is told to skip ahead to the frame that is due now. The frames in between are dropped,
+ * and the frame on screen stays there for the slots they would have had, duplicating it.
+ */
+class FramePacer final {
+public:
+    struct Stats {
+        u32 fps;
+        usize presented;
+        usize dropped;
+        // Presents that came after the slot of the following frame had already begun.
+        usize late;
+        // Time between the first and the last present.
+        u64 elapsed_cycles;
+        // Shortest and longest time between two presents.
+        u64 min_interval_cycles;
+        u64 max_interval_cycles;
+        // TSC rate, measured against the timer over the whole run.
+        u64 cycles_per_second;
+
+        void print() const;
+    };
+
+    FramePacer(Timer&, u32 fps);
+
+    /**
+     * Starts the clock, frame 0 is due right away.
+     */
+    void start();
+    /**
+     * Waits until the next frame is due.
+     * @return Index of the frame to present, which is further ahead than the last one plus one if frames were dropped.
+     */
+    u64 wait_for_frame();
+    /**
+     * Records that the frame returned by wait_for_frame() is on screen now.
+     */
+    void presented();
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    Timer& m_timer;
+    u32 m_fps;
+    u64 m_start_tick { 0 };
+    u64 m_start_cycles { 0 };
+    u64 m_next_frame { 0 };
+
+    usize m_presented { 0 };
+    usize m_dropped { 0 };
+    usize m_late { 0 };
+    u64 m_first_present_cycles { 0 };
+    u64 m_last_present_cycles { 0 };
+    u64 m_min_interval_cycles { 0 };
+    u64 m_max_interval_cycles { 0 };
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel::Time {
+
+/**
+ * System tick counter, driven by PIT channel 0 raising IRQ 0 at a fixed rate.
+ * The PIT can only divide its oscillator by an integer, so the real tick rate is slightly off the requested one.
+ * Conversions between ticks and time use the real rate, so they don't drift.
+ */
+class Timer final {
+public:
+    // Runs a bounded piece of background work. Returns false once there is nothing left to do.
+    using IdleHook = bool (*)();
+
+    static Timer& get() { return s_instance; }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+    Timer(Timer&&) = delete;
+    Timer& operator=(Timer&&) = delete;
+
+    /**
+     * Programs the PIT to tick at about frequency Hz and unmasks IRQ 0. Needs the IDT and PIC to be set up,
+     * ticks are counted once interrupts are enabled.
+     */
+    void initialize(u32 frequency);
+
+    [[nodiscard]] u64 ticks() const;
+    [[nodiscard]] u32 frequency() const { return m_frequency; }
+
+    /**
+     * Returns the number of ticks in amount / per_second seconds, rounded up.
+     */
+    [[nodiscard]] u64 ticks_for(u64 amount, u32 per_second) const;
+    /**
+     * Returns how many 1 / per_second seconds fit into the given number of ticks, rounded down.
+     */
+    [[nodiscard]] u64 time_in(u64 ticks, u32 per_second) const;
+
+    /**
+     * Halts the CPU until the tick count reaches tick. Interrupts have to be enabled.
+     * While more than a tick is left, the idle hook gets the time first.
+     */
+    void wait_until(u64 tick) const;
+
+    /**
+     * Sets the work done while waiting in wait_until(), or nullptr for none.
+     * Each call of the hook should be short, or it delays the end of the wait.
+     */
+    void set_idle_hook(IdleHook hook) { m_idle_hook = hook; }
+
+    // Called from the IRQ 0 handler only.
+    void tick() { m_ticks = m_ticks + 1; }
+
+private:
+    constexpr Timer() = default;
+
+    // Constant-initialized, so the IRQ 0 handler reaches it without a guard check or any setup having run.
+    static Timer s_instance;
+
+    IdleHook m_idle_hook { nullptr };
+    volatile u64 m_ticks { 0 };
+    u32 m_frequency { 0 };
+    // PIT divisor, the real tick rate is OSCILLATOR_FREQUENCY / m_count.
+    u32 m_count { 0 };
+};
+
+}
@@ -35,4 +35,18 @@ usize eflags();
 
 u64 rdtsc();
 
+usize read_cr0();
+void write_cr0(usize);
+usize read_cr3();
+void write_cr3(usize);
+usize read_cr4();
+void write_cr4(usize);
+// Drops the TLB entry for the page containing the given address, global or not.
+void invlpg(usize address);
+// Writes back and invalidates every cache line. Needed around memory type changes.
+void wbinvd();
+
+u64 rdmsr(u32 msr);
+void wrmsr(u32 msr, u64 value);
+
 }
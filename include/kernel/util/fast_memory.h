@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+/**
+ * Copies size bytes into memory that is written but not read back, like VRAM. With SSE2, the bulk is written with
+ * 16 byte non-temporal stores, which go around the cache instead of evicting everything else from it.
+ * Falls back to memcpy without SSE2.
+ */
+void stream_copy(void* destination, const void* source, usize size);
+
+/**
+ * Copies size bytes between buffers that stay in use, with 16 byte SSE2 loads and stores through the cache where
+ * available, and 4 byte string moves otherwise. The buffers must not overlap.
+ */
+void fast_copy(void* destination, const void* source, usize size);
+
+/**
+ * Sets size bytes to value, with 16 byte SSE2 stores where available and memset otherwise.
+ * The stores go through the cache, as filled memory is usually read again soon.
+ */
+void fast_fill(void* destination, u8 value, usize size);
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <kernel/util/asm.h>
+
+namespace Kernel {
+
+/**
+ * Lock that busy-waits until it is free, with interrupts disabled for as long as it is held.
+ * Disabling interrupts keeps an interrupt handler from spinning forever on a lock held by the code it interrupted,
+ * so critical sections should be kept as short as possible.
+ * The lock remembers the longest time it was held in TSC cycles, which bounds the interrupt latency it causes.
+ */
+class Spinlock final {
+public:
+    void lock() {
+        const auto interrupts_enabled = has_flag(CPUFlag::InterruptEnable);
+        cli();
+        while (__atomic_test_and_set(&m_locked, __ATOMIC_ACQUIRE))
+            __builtin_ia32_pause();
+
+        m_restore_interrupts = interrupts_enabled;
+        m_acquired_at = rdtsc();
+    }
+
+    void unlock() {
+        const auto held = rdtsc() - m_acquired_at;
+        if (held > m_max_hold_cycles)
+            m_max_hold_cycles = held;
+
+        const auto restore_interrupts = m_restore_interrupts;
+        __atomic_clear(&m_locked, __ATOMIC_RELEASE);
+        if (restore_interrupts)
+            sti();
+    }
+
+    [[nodiscard]] u64 max_hold_cycles() const { return m_max_hold_cycles; }
+
+private:
+    bool m_locked { false };
+    bool m_restore_interrupts { false };
+    u64 m_acquired_at { 0 };
+    u64 m_max_hold_cycles { 0 };
+};
+
+/**
+ * Holds a Spinlock for the lifetime of the scope.
+ */
+class ScopedSpinlock final {
+public:
+    explicit ScopedSpinlock(Spinlock& lock)
+        : m_lock(lock) {
+        m_lock.lock();
+    }
+
+    ~ScopedSpinlock() { m_lock.unlock(); }
+
+    ScopedSpinlock(const ScopedSpinlock&) = delete;
+    ScopedSpinlock& operator=(const ScopedSpinlock&) = delete;
+
+private:
+    Spinlock& m_lock;
+};
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+struct Rect {
+    u32 x;
+    u32 y;
+    u32 width;
+    u32 height;
+
+    [[nodiscard]] u32 right() const { return x + width; }
+    [[nodiscard]] u32 bottom() const { return y + height; }
+    [[nodiscard]] usize area() const { return static_cast<usize>(width) * height; }
+    [[nodiscard]] bool is_empty() const { return width == 0 || height == 0; }
+
+    /**
+     * Returns whether the two rectangles overlap or share an edge, so that their union covers no extra pixels
+     * when they line up. Rectangles that only meet at a corner don't count, their union would add two rectangles'
+     * worth of undamaged pixels.
+     */
+    [[nodiscard]] bool touches(const Rect& other) const {
+        const auto x_overlaps = x < other.right() && other.x < right();
+        const auto y_overlaps = y < other.bottom() && other.y < bottom();
+        const auto x_meets = x <= other.right() && other.x <= right();
+        const auto y_meets = y <= other.bottom() && other.y <= bottom();
+        return (x_overlaps && y_meets) || (y_overlaps && x_meets);
+    }
+
+    /**
+     * Returns the smallest rectangle containing both.
+     */
+    [[nodiscard]] Rect united(const Rect& other) const;
+    /**
+     * Returns the part of the rectangle inside [0, width) x [0, height), which may be empty.
+     */
+    [[nodiscard]] Rect clipped(u32 max_width, u32 max_height) const;
+};
+
+/**
+ * Records which parts of a screen changed since it was last presented, as a short list of rectangles.
+ * Rectangles that overlap or touch are coalesced as they are added. Once the list is full, a new rectangle is merged
+ * into whichever existing one grows the least. When the damaged area passes FULL_FRAME_PERCENT of the screen,
+ * tracking stops and the whole frame counts as damaged, as copying it in one go is cheaper than row by row.
+ */
+class DamageTracker final {
+public:
+    static constexpr usize MAX_RECTS = 8;
+    static constexpr usize FULL_FRAME_PERCENT = 50;
+
+    DamageTracker(u32 width, u32 height)
+        : m_width(width)
+        , m_height(height) { }
+
+    void add(const Rect&);
+    void add_full_frame() { m_full_frame = true; }
+    void reset();
+
+    [[nodiscard]] bool is_full_frame() const { return m_full_frame; }
+    [[nodiscard]] bool is_empty() const { return !m_full_frame && m_count == 0; }
+    [[nodiscard]] usize count() const { return m_count; }
+    [[nodiscard]] const Rect& rect(usize index) const { return m_rects[index]; }
+
+private:
+    void remove_at(usize index);
+
+    Rect m_rects[MAX_RECTS];
+    usize m_count { 0 };
+    usize m_area { 0 };
+    bool m_full_frame { false };
+    u32 m_width;
+    u32 m_height;
+};
+
+}
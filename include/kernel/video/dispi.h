@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel::DISPI {
+
+/**
+ * Registers of the Bochs display interface, which QEMU's `-vga std`, Bochs and VirtualBox implement.
+ */
+enum class Register : u16 {
+    ID = 0x0,
+    XResolution = 0x1,
+    YResolution = 0x2,
+    BitsPerPixel = 0x3,
+    Enable = 0x4,
+    Bank = 0x5,
+    VirtualWidth = 0x6,
+    VirtualHeight = 0x7,
+    XOffset = 0x8,
+    YOffset = 0x9,
+    VideoMemory64K = 0xa,
+};
+
+u16 read(Register);
+void write(Register, u16);
+
+/**
+ * Returns whether the DISPI registers respond, and the adapter scans out the given mode from its linear framebuffer.
+ */
+bool is_active(u32 width, u32 height, u32 depth, u32 pitch);
+
+/**
+ * Returns how many full frames of the current mode fit into the virtual screen, which extends past the visible one
+ * as far as video memory allows.
+ */
+u32 page_count(u32 height);
+
+/**
+ * Scans out from the given line of the virtual screen. Takes effect immediately, without waiting for vertical blank.
+ */
+void set_y_offset(u32 line);
+
+}
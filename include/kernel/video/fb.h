@@ -1,12 +1,29 @@
 #pragma once
 
 #include <kernel/multiboot/mb.h>
+#include <kernel/video/damage.h>
+#include <kernel/video/image.h>
+#include <kernel/video/pixel_format.h>
 
 namespace Kernel {
 
 class Framebuffer final {
 public:
-    Framebuffer(u8* hw_buffer, u32 width, u32 height, u32 pitch, u32 depth);
+    struct PresentStats {
+        usize presents;
+        // TSC cycles spent in swap_buffers().
+        u64 total_cycles;
+        u64 max_cycles;
+        bool page_flipping;
+
+        void print() const;
+    };
+
+    /**
+     * @brief With page_flipping, hw_buffer has to hold two frames, and the back buffer is the second one in video
+     *        memory instead of a copy in RAM. Presenting then flips the scanout offset through the DISPI interface.
+     */
+    Framebuffer(u8* hw_buffer, u32 width, u32 height, u32 pitch, u32 depth, bool page_flipping);
     ~Framebuffer();
 
     /**
@@ -15,28 +32,71 @@ public:
      * 
      * @see swap_buffers()
      */
-    [[nodiscard]] u8* write_buffer() const;
+    [[nodiscard]] u8* write_buffer();
     /**
      * @brief Swap front and back buffers and copy their contents to hardware.
+     *        Only the rectangles damaged since the last call are copied, or the whole frame if most of it changed.
+     *        With page flipping nothing is copied, the pages just trade places.
      */
     void swap_buffers();
 
+    /**
+     * @brief Clear everything drawn since the last clear to black.
+     */
     void clear();
+    /**
+     * @brief Fill a rectangle of the back buffer with a 0xRRGGBB color. Clipped to the screen.
+     */
+    void fill_rect(const Rect&, u32 color);
+    /**
+     * @brief Draw a horizontal line of width pixels starting at (x, y), with a 0xRRGGBB color. Clipped to the screen.
+     */
+    void hline(u32 x, u32 y, u32 width, u32 color);
+    /**
+     * @brief Draw an image with its top left corner at (x, y), every pixel scaled up to scale x scale pixels.
+     *        Each source row is expanded once and then copied to the rows below it. Clipped to the screen.
+     */
+    void blit(const Image&, u32 x, u32 y, u32 scale);
+    /**
+     * @brief Mark a rectangle as changed after drawing into `write_buffer()` directly,
+     *        so that the next `swap_buffers()` presents it.
+     */
+    void mark_dirty(const Rect&);
 
     [[nodiscard]] u32 width() const;
     [[nodiscard]] u32 height() const;
     [[nodiscard]] u32 pitch() const;
     [[nodiscard]] u32 depth() const;
     [[nodiscard]] u32 size() const;
+    [[nodiscard]] bool is_page_flipping() const { return m_page_flipping; }
+    [[nodiscard]] PresentStats present_stats() const { return m_present_stats; }
 
 private:
+    // After a flip, the new back page still holds the frame before the one just presented. The damage of the
+    // presented frame is copied over on first use, unless clear() makes that unnecessary.
+    void catch_up_back_buffer();
+    void copy_damage(u8* destination, const u8* source, const DamageTracker&) const;
+
     u8* m_front_buffer;
     u32 m_width;
     u32 m_height;
     u32 m_pitch;
     u32 m_depth;
     u32 m_buffer_size;
+    u32 m_bytes_per_pixel;
+    // Drawing primitives specialised for m_depth, picked once on construction.
+    const PixelOperations* m_pixels;
     u8* m_back_buffer;
+    DamageTracker m_damage;
+    // Bounding box of everything drawn into a page since its last clear(), which is all clear() has to erase.
+    // Without page flipping, only the first one is used.
+    Rect m_drawn[2];
+
+    bool m_page_flipping;
+    u32 m_back_page;
+    DamageTracker m_stale;
+    bool m_back_buffer_stale { false };
+    PresentStats m_present_stats {};
 };
 
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <kernel/video/fb.h>
+
+namespace Kernel {
+
+/**
+ * @brief A text console drawn into a framebuffer with the built-in 8x16 font, for when the VGA text buffer is not
+ *        on screen. Characters go into a grid of VGA text mode entries and are only drawn by `flush()`, which redraws
+ *        the lines changed since the last flush and scrolls by moving the pixel rows that are already drawn.
+ */
+class FramebufferConsole final {
+public:
+    // Lines written between automatic flushes.
+    static constexpr u32 FLUSH_INTERVAL = 8;
+    // Each slot holds one character pre-expanded to pixels in one color pair.
+    static constexpr usize GLYPH_CACHE_SIZE = 512;
+
+    explicit FramebufferConsole(Framebuffer&);
+    ~FramebufferConsole();
+
+    /**
+     * @brief Write a character with a VGA text mode color attribute.
+     */
+    void put_char(char, u8 color);
+    /**
+     * @brief Draw everything written since the last flush and present it.
+     */
+    void flush();
+    /**
+     * @brief Redraw every line on the next flush, after something else drew over the console.
+     */
+    void invalidate();
+
+    [[nodiscard]] u32 columns() const { return m_columns; }
+    [[nodiscard]] u32 rows() const { return m_rows; }
+
+private:
+    void new_line(u8 color);
+    void scroll_pixels(u8* buffer, u32 lines) const;
+    void draw_line(u8* buffer, u32 row);
+    const u8* expanded_glyph(u16 entry);
+
+    Framebuffer& m_framebuffer;
+    const PixelOperations* m_pixels;
+    u32 m_palette[16];
+    u32 m_columns;
+    u32 m_rows;
+    u32 m_column { 0 };
+    u32 m_row { 0 };
+
+    u16* m_cells;
+    bool* m_dirty_lines;
+    bool m_dirty { false };
+    // Lines the grid moved up since the last flush, which the drawn pixels have yet to follow.
+    u32 m_pending_scroll { 0 };
+    u32 m_lines_since_flush { 0 };
+
+    // Bytes of one glyph row and one whole glyph, in the framebuffer's pixel format.
+    u32 m_glyph_pitch;
+    u32 m_glyph_size;
+    u8* m_glyph_cache;
+    u32* m_glyph_cache_keys;
+};
+
+}
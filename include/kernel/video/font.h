@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel::Font {
+
+static constexpr u32 GLYPH_WIDTH = 8;
+static constexpr u32 GLYPH_HEIGHT = 16;
+
+/**
+ * Returns the 8x16 bitmap of a character: one byte per row from the top, the most significant bit being the leftmost
+ * pixel, the same layout PSF fonts use for 8 pixel wide glyphs. Anything outside printable ASCII is drawn as a box.
+ */
+const u8* glyph(char);
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+enum class ImageFormat : u8 {
+    // One byte of luma per pixel.
+    Gray8,
+    // Red, green and blue bytes per pixel, in that order.
+    RGB24,
+};
+
+/**
+ * A read-only view of pixels in memory, to be drawn with Framebuffer::blit().
+ */
+struct Image {
+    const u8* pixels;
+    u32 width;
+    u32 height;
+    // Bytes from the start of one row to the next.
+    u32 stride;
+    ImageFormat format;
+
+    [[nodiscard]] const u8* row(u32 y) const { return pixels + y * stride; }
+};
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <kernel/video/image.h>
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+/**
+ * 24-bit packed pixels, with blue, green and red bytes in memory order. Pixels are not aligned to anything.
+ */
+struct RGB24Format {
+    static constexpr u32 BYTES_PER_PIXEL = 3;
+
+    static constexpr u32 from_rgb(u32 rgb) { return rgb; }
+    static void store(u8* destination, u32 pixel) {
+        destination[0] = static_cast<u8>(pixel);
+        destination[1] = static_cast<u8>(pixel >> 8);
+        destination[2] = static_cast<u8>(pixel >> 16);
+    }
+};
+
+/**
+ * 32-bit pixels, 0x00RRGGBB in little endian, so every pixel is one aligned 32-bit store.
+ */
+struct XRGB32Format {
+    static constexpr u32 BYTES_PER_PIXEL = 4;
+
+    static constexpr u32 from_rgb(u32 rgb) { return rgb & 0xffffff; }
+    static void store(u8* destination, u32 pixel) { *reinterpret_cast<u32*>(destination) = pixel; }
+};
+
+/**
+ * 16-bit pixels with 5 bits of red, 6 of green and 5 of blue.
+ */
+struct RGB565Format {
+    static constexpr u32 BYTES_PER_PIXEL = 2;
+
+    static constexpr u32 from_rgb(u32 rgb) {
+        return ((rgb >> 8) & 0xf800) | ((rgb >> 5) & 0x07e0) | ((rgb >> 3) & 0x001f);
+    }
+    static void store(u8* destination, u32 pixel) { *reinterpret_cast<u16*>(destination) = static_cast<u16>(pixel); }
+};
+
+/**
+ * The drawing primitives for one pixel format, compiled separately for each of them.
+ * Framebuffer picks the table matching its depth once, so the inner loops never look at the format.
+ */
+struct PixelOperations {
+    u32 bytes_per_pixel;
+    // Converts 0xRRGGBB to the format's pixel value.
+    u32 (*from_rgb)(u32 rgb);
+    // Writes count copies of a pixel value.
+    void (*fill_span)(u8* destination, u32 pixel, u32 count);
+    // Converts one image row, every pixel repeated scale times, into width pixels starting at destination.
+    void (*convert_row)(u8* destination, const Image&, const u8* row, u32 scale, u32 width);
+
+    /**
+     * Returns the operations for a framebuffer depth, 16 (as 5:6:5), 24 or 32 bits per pixel.
+     * @return nullptr for any other depth.
+     */
+    static const PixelOperations* for_depth(u32 depth);
+};
+
+}
@@ -2,6 +2,12 @@
 
 #include <stdlib/types.h>
 
+namespace Kernel {
+
+class FramebufferConsole;
+
+}
+
 namespace Kernel::VGA {
 
 enum class Color : u8;
@@ -17,6 +23,15 @@ bool is_initialized();
 int put_entry_at(char, u8 color, usize, usize);
 int put_char(char);
 int write(const char*, usize);
+/**
+ * Sends all further output to a framebuffer console instead of the VGA text buffer, starting with whatever was
+ * written before, as far as it is still kept. Pass nullptr to go back to the VGA text buffer.
+ */
+void attach_console(FramebufferConsole*);
+/**
+ * Draws pending output of the attached console, if any.
+ */
+void flush();
 
 namespace Cursor {
 
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdlib/optional.h>
+#include <stdlib/types.h>
+
+namespace Kernel {
+
+class Framebuffer;
+
+/**
+ * Streaming decoder for the delta-coded grayscale video format written by tools/encode_video.py.
+ *
+ * A stream starts with a 12 byte header: the magic "BAV1", then width and height as u16 and the frame count as u32,
+ * all little endian. Every pixel is 4-bit luma. Each frame is coded against the previous one (the first one
+ * against black) as tokens covering exactly width * height pixels in row-major order:
+ *   0ccccccc    skip c + 1 unchanged pixels
+ *   1vvvvccc    run of c + 1 pixels of luma v
+ * A count field with all bits set is followed by a LEB128 number that is added to it, for longer skips and runs.
+ *
+ * The decoder never holds a whole frame. Runs are drawn straight into the framebuffer as they are decoded,
+ * and skipped pixels are not touched at all, so the framebuffer's back buffer has to keep the previous frame.
+ */
+class VideoDecoder final {
+public:
+    VideoDecoder() = default;
+
+    /**
+     * Checks the header of an encoded stream.
+     * @return The decoder positioned at the first frame, or an empty Optional if the data is not a valid stream.
+     */
+    static Optional<VideoDecoder> open(const u8* data, usize size);
+
+    /**
+     * Decodes the next frame into the framebuffer, with the top left corner at (x, y) and every pixel scaled up to
+     * scale x scale pixels.
+     * @return false once all frames are decoded, or if the stream is truncated or corrupt.
+     */
+    bool decode_frame(Framebuffer&, u32 x, u32 y, u32 scale);
+
+    [[nodiscard]] u32 width() const { return m_width; }
+    [[nodiscard]] u32 height() const { return m_height; }
+    [[nodiscard]] u32 frame_count() const { return m_frame_count; }
+    [[nodiscard]] u32 frames_decoded() const { return m_frames_decoded; }
+
+private:
+    // Reads a token's count field, including its LEB128 extension.
+    bool read_count(u32 field, u32 field_max, u32& count);
+
+    const u8* m_data { nullptr };
+    const u8* m_end { nullptr };
+    u32 m_width { 0 };
+    u32 m_height { 0 };
+    u32 m_frame_count { 0 };
+    u32 m_frames_decoded { 0 };
+};
+
+}
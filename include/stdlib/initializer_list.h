@@ -41,3 +41,6 @@ template <typename T>
 inline constexpr const T* end(initializer_list<T> il) noexcept { return il.end(); }
 
 }
+
+template <typename T>
+using InitializerList = std::initializer_list<T>;
@@ -50,5 +50,20 @@ struct allocator {
      * @see https://en.cppreference.com/w/cpp/memory/allocator/deallocate
      * @param p pointer obtained from allocate()
      */
-    constexpr void deallocate(pointer p, size_type n) { ::operator delete(p, n); }
+    constexpr void deallocate(pointer p, size_type n) { ::operator delete(p, n * sizeof(value_type)); }
+
+    /**
+     * Resizes the storage referenced by the pointer p to hold new_n objects, in place if possible.
+     * The first min(n, new_n) objects are preserved. They are relocated bytewise if the storage has to move,
+     * so this must only be used for trivially copyable types.
+     * This is an extension, std::allocator has no equivalent.
+     * Running out of memory is fatal, so the result is never `nullptr`.
+     * @param p pointer obtained from allocate()
+     * @param n the number of objects p was allocated for
+     * @param new_n the number of objects the storage has to hold afterwards
+     * @return Pointer to the resized storage, p itself if it could be resized in place.
+     */
+    [[nodiscard]] pointer reallocate(pointer p, [[maybe_unused]] size_type n, size_type new_n) {
+        return static_cast<pointer>(krealloc(p, new_n * sizeof(value_type)));
+    }
 };
\ No newline at end of file
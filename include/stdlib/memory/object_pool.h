@@ -0,0 +1,143 @@
+#pragma once
+
+#include <kernel/heap/kmalloc.h>
+#include <stdlib/assert.h>
+#include <stdlib/memory/unique_ptr.h>
+#include <stdlib/move.h>
+#include <stdlib/types.h>
+
+/**
+ * Pool of objects of a single type, for objects that are created and destroyed over and over.
+ * Storage is allocated from the heap in slabs of SlabCapacity objects and never given back until the pool is destroyed.
+ * Freed slots are kept on an intrusive free list threaded through the slots themselves, so creating and destroying
+ * an object is O(1) and carries no per-object header.
+ * @code {.cpp}
+ * // Example usage:
+ * void test_object_pool()
+ * {
+ *     ObjectPool<Timer> pool;
+ *     auto timer = pool.make(42);
+ *     timer->start();
+ * } // timer goes back to the pool here
+ * @endcode
+ * @tparam T The type of the objects.
+ * @tparam SlabCapacity The number of objects allocated at once when the pool runs out of free slots.
+ */
+template <typename T, usize SlabCapacity = 32>
+class ObjectPool final {
+public:
+    /**
+     * UniquePtr deleter that destroys the object and returns its slot to the pool it came from.
+     */
+    class Deleter final {
+    public:
+        constexpr explicit Deleter(ObjectPool& pool)
+            : m_pool(&pool) {
+        }
+
+        void operator()(T* object) const { m_pool->destroy(object); }
+
+    private:
+        ObjectPool* m_pool;
+    };
+
+    using Pointer = UniquePtr<T, Deleter>;
+
+    constexpr ObjectPool() = default;
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    ObjectPool(ObjectPool&&) = delete;
+    ObjectPool& operator=(ObjectPool&&) = delete;
+
+    ~ObjectPool() {
+        assert_msg(m_live == 0, "ObjectPool destroyed while objects are still alive");
+
+        auto* slab = m_slabs;
+        while (slab) {
+            auto* next = slab->next;
+            kfree(slab);
+            slab = next;
+        }
+    }
+
+    /**
+     * Constructs an object in a free slot, allocating a new slab if there is none.
+     * @return Pointer to the object, which has to be given back with destroy().
+     */
+    template <typename... Args>
+    [[nodiscard]] T* create(Args&&... args) {
+        if (!m_free_list)
+            add_slab();
+
+        auto* slot = m_free_list;
+        m_free_list = slot->next;
+        m_live++;
+        return new (slot->storage) T(forward<Args>(args)...);
+    }
+
+    /**
+     * Like create(), but returns the object in a UniquePtr that gives it back to this pool.
+     */
+    template <typename... Args>
+    [[nodiscard]] Pointer make(Args&&... args) {
+        return Pointer(create(forward<Args>(args)...), Deleter(*this));
+    }
+
+    /**
+     * Destroys an object created by this pool and puts its slot on the free list.
+     */
+    void destroy(T* object) {
+        if (!object)
+            return;
+        assert(m_live > 0);
+
+        object->~T();
+        auto* slot = reinterpret_cast<Slot*>(object);
+        slot->next = m_free_list;
+        m_free_list = slot;
+        m_live--;
+    }
+
+    /**
+     * Allocates slabs until at least count objects fit into the pool without touching the heap again.
+     */
+    void reserve(usize count) {
+        while (m_capacity < count)
+            add_slab();
+    }
+
+    [[nodiscard]] usize live() const { return m_live; }
+    [[nodiscard]] usize capacity() const { return m_capacity; }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) u8 storage[sizeof(T)];
+    };
+
+    struct Slab {
+        Slab* next;
+        Slot slots[SlabCapacity];
+    };
+
+    void add_slab() {
+        auto* slab = static_cast<Slab*>(kmalloc_aligned(sizeof(Slab), alignof(Slab)));
+        assert_msg(slab, "ObjectPool: Out of memory.");
+
+        slab->next = m_slabs;
+        m_slabs = slab;
+
+        // Thread the new slots onto the free list back to front, so they are handed out in address order.
+        for (usize i = SlabCapacity; i > 0; i--) {
+            slab->slots[i - 1].next = m_free_list;
+            m_free_list = &slab->slots[i - 1];
+        }
+        m_capacity += SlabCapacity;
+    }
+
+    Slab* m_slabs { nullptr };
+    Slot* m_free_list { nullptr };
+    usize m_live { 0 };
+    usize m_capacity { 0 };
+};
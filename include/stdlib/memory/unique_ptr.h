@@ -4,6 +4,14 @@
 #include <stdlib/move.h>
 #include <stdlib/types.h>
 
+/**
+ * Default deleter of UniquePtr, destroys the object with `delete`.
+ */
+template <typename T>
+struct DefaultDelete {
+    constexpr void operator()(T* ptr) const { delete ptr; }
+};
+
 /**
  * Smart pointer for unique ownership. Resources are automatically freed when the pointer goes out of scope.
  * @code {.cpp}
@@ -16,8 +24,9 @@
  * }
  * @encode
  * @tparam T The type of the resource.
+ * @tparam Deleter Callable that frees the resource, e.g. to return it to an ObjectPool instead of the heap.
  */
-template <typename T>
+template <typename T, typename Deleter = DefaultDelete<T>>
 class UniquePtr final {
 public:
     constexpr UniquePtr() = default;
@@ -25,13 +34,19 @@ public:
         : m_ptr(ptr) {
     }
 
+    constexpr UniquePtr(T* ptr, Deleter deleter)
+        : m_ptr(ptr)
+        , m_deleter(move(deleter)) {
+    }
+
     template <typename U>
     constexpr UniquePtr(U* ptr)
         : m_ptr(ptr) {
     }
 
     constexpr UniquePtr(UniquePtr&& other)
-        : m_ptr(other.release()) {
+        : m_ptr(other.release())
+        , m_deleter(move(other.m_deleter)) {
     }
 
     template <typename... Args>
@@ -47,7 +62,9 @@ public:
     }
 
     constexpr UniquePtr& operator=(UniquePtr&& other) {
+        // The current object still has to go through the current deleter.
         reset(other.release());
+        m_deleter = move(other.m_deleter);
         return *this;
     }
 
@@ -59,7 +76,7 @@ public:
 
     constexpr void reset(T* ptr = nullptr) {
         if (m_ptr)
-            delete m_ptr;
+            m_deleter(m_ptr);
         m_ptr = ptr;
     }
 
@@ -67,12 +84,20 @@ public:
         T* ptr = m_ptr;
         m_ptr = other.m_ptr;
         other.m_ptr = ptr;
+
+        Deleter deleter = move(m_deleter);
+        m_deleter = move(other.m_deleter);
+        other.m_deleter = move(deleter);
     }
 
     constexpr T* get() const {
         return m_ptr;
     }
 
+    constexpr const Deleter& get_deleter() const {
+        return m_deleter;
+    }
+
     constexpr operator bool() const {
         return m_ptr != nullptr;
     }
@@ -88,6 +113,7 @@ public:
     // clang-format off
 private:
     T* m_ptr = nullptr;
+    [[no_unique_address]] Deleter m_deleter;
     // clang-format on
 };
 
@@ -39,6 +39,15 @@ public:
         : m_allocator(allocator_type()) {
     }
 
+    /**
+     * Constructs empty string (zero size and unspecified capacity) using the given allocator.
+     * @see https://en.cppreference.com/w/cpp/string/basic_string/basic_string (1)
+     * @param alloc allocator to use for all memory allocations of this string
+     */
+    constexpr explicit BasicString(const allocator_type& alloc)
+        : m_allocator(alloc) {
+    }
+
     /**
      * Constructs the string with count copies of character ch.
      * @see https://en.cppreference.com/w/cpp/string/basic_string/basic_string (2)
@@ -88,6 +97,18 @@ public:
         assign(s);
     }
 
+    /**
+     * Constructs the string with the contents initialized with a copy of the null-terminated character string pointed to by s,
+     * using the given allocator.
+     * @see https://en.cppreference.com/w/cpp/string/basic_string/basic_string (5)
+     * @param s pointer to an array of characters to use as source to initialize the string with
+     * @param alloc allocator to use for all memory allocations of this string
+     */
+    constexpr BasicString(const_pointer s, const allocator_type& alloc)
+        : m_allocator(alloc) {
+        assign(s);
+    }
+
     /**
      * Replaces the contents with count copies of character ch.
      * @see https://en.cppreference.com/w/cpp/string/basic_string/assign (1)
@@ -860,6 +881,18 @@ private:
                 optimal_cap *= grow_factor;
         }
 
+        // Let the allocator resize the buffer in place if it knows how to.
+        if constexpr (requires { m_allocator.reallocate(m_data, m_capacity, optimal_cap); }) {
+            if !consteval {
+                if (m_data) {
+                    m_data = m_allocator.reallocate(m_data, capacity(), optimal_cap);
+                    m_capacity = optimal_cap;
+                    clear_unused();
+                    return;
+                }
+            }
+        }
+
         // Allocate a new buffer and copy the old data into it.
         auto new_buffer = m_allocator.allocate(optimal_cap);
         if (m_data) {
@@ -872,6 +905,13 @@ private:
         // Set the new buffer.
         m_data = new_buffer;
         m_capacity = optimal_cap;
+        clear_unused();
+    }
+
+    // Allocated storage is not zeroed. Restore the terminator and clear the unused capacity behind it.
+    constexpr void clear_unused() {
+        if (m_capacity > length())
+            cmptime::memset(m_data + length(), 0, m_capacity - length());
     }
 
     constexpr void dispose() {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <libc/string.h>
 #include <stdlib/initializer_list.h>
 #include <stdlib/memory/allocator.h>
 #include <stdlib/move.h>
@@ -25,6 +26,10 @@ public:
         : m_allocator(allocator_type()) {
     }
 
+    constexpr explicit Vector(const allocator_type& alloc)
+        : m_allocator(alloc) {
+    }
+
     constexpr explicit Vector(size_type count, const_reference value) { assign(count, value); }
 
     constexpr explicit Vector(size_type count) { assign(count, value_type()); }
@@ -100,6 +105,17 @@ private:
         while (new_capacity > optimal_cap)
             optimal_cap *= grow_factor;
 
+        // Let the allocator grow the buffer in place if it knows how to.
+        if constexpr (requires { m_allocator.reallocate(m_data, m_capacity, optimal_cap); }) {
+            if !consteval {
+                if (m_data) {
+                    m_data = m_allocator.reallocate(m_data, capacity(), optimal_cap);
+                    m_capacity = optimal_cap;
+                    return;
+                }
+            }
+        }
+
         // Allocate a new buffer and copy the old data into it.
         auto new_buffer = m_allocator.allocate(optimal_cap);
         if (m_data) {
@@ -0,0 +1,44 @@
+#include <kernel/heap/allocation_trace.h>
+#include <kernel/io/serial.h>
+#include <kernel/util/asm.h>
+
+namespace Kernel {
+
+void AllocationTrace::record(AllocationEvent event, const void* pointer, usize size, usize chunks, const void* caller) {
+    if (!m_enabled)
+        return;
+
+    auto& record = m_records[m_recorded & (CAPACITY - 1)];
+    record.timestamp = rdtsc();
+    record.pointer = reinterpret_cast<usize>(pointer);
+    record.caller = reinterpret_cast<usize>(caller);
+    record.size = static_cast<u32>(size);
+    record.chunks = static_cast<u32>(chunks);
+    record.event = event;
+    m_recorded++;
+}
+
+static void write_u32(u32 value) {
+    for (usize i = 0; i < sizeof(u32); i++)
+        IO::Serial::write(static_cast<u8>(value >> (i * 8)));
+}
+
+void AllocationTrace::dump() const {
+    if (!IO::Serial::ready())
+        return;
+
+    const auto count = size();
+    IO::Serial::write_string("ATRC", 4);
+    write_u32(sizeof(AllocationRecord));
+    write_u32(static_cast<u32>(count));
+    write_u32(m_recorded);
+
+    // Once the ring has wrapped, the oldest record is the one that will be overwritten next.
+    const auto first = m_recorded - count;
+    for (usize i = 0; i < count; i++) {
+        const auto& record = m_records[(first + i) & (CAPACITY - 1)];
+        IO::Serial::write_string(reinterpret_cast<const char*>(&record), sizeof(AllocationRecord));
+    }
+}
+
+}
@@ -0,0 +1,136 @@
+#include <kernel/heap/arena.h>
+#include <kernel/heap/kmalloc.h>
+#include <kernel/util/kassert.h>
+
+namespace Kernel {
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    usize capacity;
+    usize used;
+};
+
+// Keep the data area as aligned as kmalloc's own blocks.
+static constexpr usize BLOCK_HEADER_SIZE = (sizeof(ArenaBlock) + Arena::DEFAULT_ALIGNMENT - 1) & ~(Arena::DEFAULT_ALIGNMENT - 1);
+
+static u8* data_of(ArenaBlock* block) {
+    return reinterpret_cast<u8*>(block) + BLOCK_HEADER_SIZE;
+}
+
+// Carves size bytes out of the block, or returns nullptr if they don't fit.
+static void* bump(ArenaBlock* block, usize size, usize alignment) {
+    const auto base = reinterpret_cast<usize>(data_of(block));
+    const auto start = (base + block->used + alignment - 1) & ~(alignment - 1);
+    if (start + size > base + block->capacity)
+        return nullptr;
+
+    block->used = start + size - base;
+    return reinterpret_cast<void*>(start);
+}
+
+void* Arena::allocate(usize size, usize alignment) {
+    kassert_msg((alignment & (alignment - 1)) == 0, "Alignment has to be a power of two");
+
+    if (m_current) {
+        if (auto* pointer = bump(m_current, size, alignment))
+            return pointer;
+
+        // Move on to a block left over from before the last reset, if the allocation fits into it.
+        if (auto* next = m_current->next; next && size + alignment <= next->capacity) {
+            m_current = next;
+            m_current->used = 0;
+            return bump(m_current, size, alignment);
+        }
+    }
+
+    // Leave room for aligning the start, the data area itself is only DEFAULT_ALIGNMENT aligned.
+    m_current = add_block(size + (alignment > DEFAULT_ALIGNMENT ? alignment : 0));
+    return bump(m_current, size, alignment);
+}
+
+ArenaBlock* Arena::add_block(usize min_size) {
+    const auto capacity = min_size > m_block_size ? min_size : m_block_size;
+    auto* block = static_cast<ArenaBlock*>(kmalloc(BLOCK_HEADER_SIZE + capacity));
+    kassert_msg(block, "Arena: Out of memory.");
+
+    block->capacity = capacity;
+    block->used = 0;
+
+    // Insert the block after the current one, so blocks kept from earlier resets stay in line for reuse.
+    if (m_current) {
+        block->next = m_current->next;
+        m_current->next = block;
+    } else {
+        block->next = m_first;
+        m_first = block;
+    }
+    return block;
+}
+
+void Arena::deallocate(void* ptr, usize size) {
+    if (!m_current || !ptr)
+        return;
+
+    auto* end = data_of(m_current) + m_current->used;
+    if (static_cast<u8*>(ptr) + size == end)
+        m_current->used -= size;
+}
+
+bool Arena::try_resize(void* ptr, usize size, usize new_size) {
+    if (!m_current || !ptr)
+        return false;
+
+    auto* data = data_of(m_current);
+    if (static_cast<u8*>(ptr) + size != data + m_current->used)
+        return false;
+
+    const auto offset = static_cast<usize>(static_cast<u8*>(ptr) - data);
+    if (offset + new_size > m_current->capacity)
+        return false;
+
+    m_current->used = offset + new_size;
+    return true;
+}
+
+Arena::Marker Arena::mark() const {
+    if (!m_current)
+        return { nullptr, 0 };
+    return { m_current, m_current->used };
+}
+
+void Arena::rewind(Marker marker) {
+    if (!marker.block) {
+        reset();
+        return;
+    }
+
+    m_current = marker.block;
+    m_current->used = marker.used;
+}
+
+void Arena::reset() {
+    m_current = m_first;
+    if (m_current)
+        m_current->used = 0;
+}
+
+void Arena::release() {
+    auto* block = m_first;
+    while (block) {
+        auto* next = block->next;
+        kfree(block);
+        block = next;
+    }
+
+    m_first = nullptr;
+    m_current = nullptr;
+}
+
+usize Arena::capacity() const {
+    usize capacity = 0;
+    for (auto* block = m_first; block; block = block->next)
+        capacity += block->capacity;
+    return capacity;
+}
+
+}
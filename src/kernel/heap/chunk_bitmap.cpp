@@ -0,0 +1,151 @@
+#include <kernel/heap/chunk_bitmap.h>
+#include <kernel/util/kassert.h>
+
+namespace Kernel {
+
+static constexpr u32 FULL_WORD = ~static_cast<u32>(0);
+
+// Mask of `count` bits starting at `bit`. count + bit must not exceed 32.
+static constexpr u32 mask_for(usize bit, usize count) {
+    if (count == ChunkBitmap::BITS_PER_WORD)
+        return FULL_WORD;
+    return ((static_cast<u32>(1) << count) - 1) << bit;
+}
+
+static inline usize lowest_set_bit(u32 word) {
+    return static_cast<usize>(__builtin_ctz(word));
+}
+
+void ChunkBitmap::initialize(u32* storage, usize chunks) {
+    m_chunks = chunks;
+    m_next_fit = 0;
+
+    auto bits = chunks;
+    for (usize level = 0; level < LEVELS; level++) {
+        const auto words = (bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+        m_levels[level] = { storage, bits };
+
+        for (usize i = 0; i < words; i++)
+            storage[i] = 0;
+        // Padding bits past the end of a level look allocated, so searches never return them.
+        if (const auto used = bits % BITS_PER_WORD; used != 0)
+            storage[words - 1] = ~mask_for(0, used);
+
+        storage += words;
+        bits = words;
+    }
+}
+
+usize ChunkBitmap::find_clear(usize level, usize index) const {
+    const auto& current = m_levels[level];
+    while (index < current.bits) {
+        const auto word = index / BITS_PER_WORD;
+        const auto bits = ~current.words[word] & (FULL_WORD << (index % BITS_PER_WORD));
+        if (bits) {
+            const auto found = word * BITS_PER_WORD + lowest_set_bit(bits);
+            return found < current.bits ? found : current.bits;
+        }
+
+        // This word is full. Ask the level above for the next word that isn't.
+        if (level + 1 == LEVELS)
+            index = (word + 1) * BITS_PER_WORD;
+        else
+            index = find_clear(level + 1, word + 1) * BITS_PER_WORD;
+    }
+    return current.bits;
+}
+
+usize ChunkBitmap::find_set(usize index, usize limit) const {
+    const auto* words = m_levels[0].words;
+    while (index < limit) {
+        const auto word = index / BITS_PER_WORD;
+        const auto bits = words[word] & (FULL_WORD << (index % BITS_PER_WORD));
+        if (bits) {
+            const auto found = word * BITS_PER_WORD + lowest_set_bit(bits);
+            return found < limit ? found : limit;
+        }
+        index = (word + 1) * BITS_PER_WORD;
+    }
+    return limit;
+}
+
+Optional<usize> ChunkBitmap::find_free_run(usize count, usize alignment, usize phase) const {
+    kassert(count > 0);
+    kassert(phase < alignment);
+
+    if (auto run = find_free_run_in(count, alignment, phase, m_next_fit, m_chunks))
+        return run;
+
+    // Wrap around. Runs starting before the cursor may still extend past it.
+    const auto end = m_next_fit + count < m_chunks ? m_next_fit + count : m_chunks;
+    return find_free_run_in(count, alignment, phase, 0, end);
+}
+
+Optional<usize> ChunkBitmap::find_free_run_in(usize count, usize alignment, usize phase, usize from, usize end) const {
+    auto start = find_clear(0, from);
+    while (start + count <= end) {
+        // Round up to the next index congruent to phase. Wrapping arithmetic works out as alignment is a power of two.
+        const auto aligned = start + ((phase - start) & (alignment - 1));
+        if (aligned != start) {
+            start = find_clear(0, aligned);
+            continue;
+        }
+
+        const auto used = find_set(start, start + count);
+        if (used == start + count)
+            return start;
+
+        start = find_clear(0, used);
+    }
+    return Optional<usize>::empty();
+}
+
+bool ChunkBitmap::is_range_clear(usize first, usize count) const {
+    if (first + count > m_chunks)
+        return false;
+    return find_set(first, first + count) == first + count;
+}
+
+void ChunkBitmap::set_range(usize first, usize count) {
+    set_range_at(0, first, count);
+    m_next_fit = first + count < m_chunks ? first + count : 0;
+}
+
+void ChunkBitmap::clear_range(usize first, usize count) {
+    clear_range_at(0, first, count);
+}
+
+void ChunkBitmap::set_range_at(usize level, usize first, usize count) {
+    auto* words = m_levels[level].words;
+    while (count > 0) {
+        const auto word = first / BITS_PER_WORD;
+        const auto bit = first % BITS_PER_WORD;
+        const auto n = count < BITS_PER_WORD - bit ? count : BITS_PER_WORD - bit;
+
+        words[word] |= mask_for(bit, n);
+        if (words[word] == FULL_WORD && level + 1 < LEVELS)
+            set_range_at(level + 1, word, 1);
+
+        first += n;
+        count -= n;
+    }
+}
+
+void ChunkBitmap::clear_range_at(usize level, usize first, usize count) {
+    auto* words = m_levels[level].words;
+    while (count > 0) {
+        const auto word = first / BITS_PER_WORD;
+        const auto bit = first % BITS_PER_WORD;
+        const auto n = count < BITS_PER_WORD - bit ? count : BITS_PER_WORD - bit;
+
+        const auto was_full = words[word] == FULL_WORD;
+        words[word] &= ~mask_for(bit, n);
+        if (was_full && level + 1 < LEVELS)
+            clear_range_at(level + 1, word, 1);
+
+        first += n;
+        count -= n;
+    }
+}
+
+}
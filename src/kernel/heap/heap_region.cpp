@@ -0,0 +1,173 @@
+#include <kernel/heap/heap_region.h>
+#include <kernel/util/kassert.h>
+
+#include <libc/string.h>
+
+namespace Kernel {
+
+static constexpr usize BITS_PER_WORD = ChunkBitmap::BITS_PER_WORD;
+static constexpr u32 FULL_WORD = ~static_cast<u32>(0);
+
+static constexpr usize round_up_to_page(usize value) {
+    return (value + HeapRegion::PAGE_SIZE - 1) & ~(HeapRegion::PAGE_SIZE - 1);
+}
+
+usize HeapRegion::metadata_size(usize size) {
+    // Sized for the whole region, which slightly overestimates as the metadata pages hold no chunks.
+    const auto chunks = size / CHUNK_SIZE;
+    const auto pages = size / PAGE_SIZE;
+    // The page map is padded to a whole word so the dirty map behind it stays aligned.
+    const auto page_map_words = (pages + sizeof(u32) - 1) / sizeof(u32);
+    return round_up_to_page((ChunkBitmap::storage_words(chunks) + page_map_words + dirty_map_words(chunks)) * sizeof(u32));
+}
+
+void HeapRegion::initialize(usize base, usize size) {
+    kassert((base % PAGE_SIZE) == 0 && (size % PAGE_SIZE) == 0);
+
+    const auto metadata = metadata_size(size);
+    kassert(size > metadata);
+
+    m_base = base;
+    m_size = size;
+    m_data_start = base + metadata;
+    m_chunks = (size - metadata) / CHUNK_SIZE;
+    m_free_chunks = m_chunks;
+
+    auto* bitmap_storage = reinterpret_cast<u32*>(base);
+    m_bitmap.initialize(bitmap_storage, m_chunks);
+
+    const auto pages = m_chunks / CHUNKS_PER_PAGE;
+    m_page_map = reinterpret_cast<u8*>(bitmap_storage + ChunkBitmap::storage_words(m_chunks));
+    memset(m_page_map, 0, pages);
+
+    // Regions come straight from the page allocator, which doesn't clear RAM, and whatever the bootloader or an earlier
+    // user left there is still there. So every chunk starts out dirty, and only becomes known to be zero once scrub()
+    // clears it while the kernel is idle. That is what lets zeroed allocations skip clearing it later.
+    m_dirty_map = reinterpret_cast<u32*>(m_page_map) + (pages + sizeof(u32) - 1) / sizeof(u32);
+    memset(m_dirty_map, 0xff, dirty_map_words(m_chunks) * sizeof(u32));
+    m_scrub_cursor = 0;
+}
+
+Optional<usize> HeapRegion::allocate(usize chunks, usize alignment, usize offset) {
+    const auto first_chunk = find(chunks, alignment, offset);
+    if (!first_chunk)
+        return first_chunk;
+
+    m_bitmap.set_range(first_chunk.value(), chunks);
+    m_free_chunks -= chunks;
+    return first_chunk;
+}
+
+Optional<usize> HeapRegion::find(usize chunks, usize alignment, usize offset) const {
+    kassert(alignment >= CHUNK_SIZE && (alignment & (alignment - 1)) == 0);
+    kassert((offset % CHUNK_SIZE) == 0);
+
+    if (chunks > m_free_chunks)
+        return Optional<usize>::empty();
+
+    // Translate the byte alignment into the chunk index the run has to start at, modulo the alignment in chunks.
+    const auto misalignment = (m_data_start + offset) & (alignment - 1);
+    const auto phase = ((alignment - misalignment) & (alignment - 1)) / CHUNK_SIZE;
+
+    return m_bitmap.find_free_run(chunks, alignment / CHUNK_SIZE, phase);
+}
+
+bool HeapRegion::try_allocate_at(usize first_chunk, usize chunks) {
+    if (chunks > m_free_chunks || !m_bitmap.is_range_clear(first_chunk, chunks))
+        return false;
+
+    m_bitmap.set_range(first_chunk, chunks);
+    m_free_chunks -= chunks;
+    return true;
+}
+
+void HeapRegion::free(usize first_chunk, usize chunks) {
+    m_bitmap.clear_range(first_chunk, chunks);
+    m_free_chunks += chunks;
+    set_dirty(first_chunk, chunks);
+}
+
+void HeapRegion::set_dirty(usize first_chunk, usize chunks) {
+    while (chunks > 0) {
+        const auto word = first_chunk / BITS_PER_WORD;
+        const auto bit = first_chunk % BITS_PER_WORD;
+        const auto n = chunks < BITS_PER_WORD - bit ? chunks : BITS_PER_WORD - bit;
+
+        m_dirty_map[word] |= n == BITS_PER_WORD ? FULL_WORD : ((static_cast<u32>(1) << n) - 1) << bit;
+
+        first_chunk += n;
+        chunks -= n;
+    }
+}
+
+usize HeapRegion::clear_dirty(usize word, u32 mask) {
+    auto dirty = m_dirty_map[word] & mask;
+    m_dirty_map[word] &= ~mask;
+
+    // Clear each contiguous run of dirty chunks in this word with a single memset.
+    usize cleared = 0;
+    while (dirty) {
+        const auto low = static_cast<usize>(__builtin_ctz(dirty));
+        const auto shifted = dirty >> low;
+        const auto run = shifted == FULL_WORD ? BITS_PER_WORD : static_cast<usize>(__builtin_ctz(~shifted));
+
+        memset(chunk_address(word * BITS_PER_WORD + low), 0, run * CHUNK_SIZE);
+        cleared += run;
+
+        if (run == BITS_PER_WORD)
+            break;
+        dirty &= ~(((static_cast<u32>(1) << run) - 1) << low);
+    }
+    return cleared;
+}
+
+HeapRegion::ChunkRange HeapRegion::take_dirty(usize first_chunk, usize chunks) {
+    const auto end = first_chunk + chunks;
+    auto dirty_start = end;
+    auto dirty_end = first_chunk;
+
+    for (auto chunk = first_chunk; chunk < end;) {
+        const auto word = chunk / BITS_PER_WORD;
+        const auto word_end = (word + 1) * BITS_PER_WORD;
+
+        auto mask = FULL_WORD << (chunk % BITS_PER_WORD);
+        if (end < word_end)
+            mask &= (static_cast<u32>(1) << (end % BITS_PER_WORD)) - 1;
+
+        const auto dirty = m_dirty_map[word] & mask;
+        m_dirty_map[word] &= ~mask;
+        if (dirty) {
+            const auto base = word * BITS_PER_WORD;
+            if (dirty_start == end)
+                dirty_start = base + static_cast<usize>(__builtin_ctz(dirty));
+            dirty_end = base + BITS_PER_WORD - static_cast<usize>(__builtin_clz(dirty));
+        }
+
+        chunk = word_end;
+    }
+
+    if (dirty_start == end)
+        return { first_chunk, 0 };
+    return { dirty_start, dirty_end - dirty_start };
+}
+
+usize HeapRegion::scrub(usize max_chunks, usize max_words) {
+    const auto words = dirty_map_words(m_chunks);
+    usize cleared = 0;
+
+    for (usize visited = 0; visited < words && visited < max_words && cleared < max_chunks; visited++) {
+        const auto word = m_scrub_cursor;
+        m_scrub_cursor = m_scrub_cursor + 1 < words ? m_scrub_cursor + 1 : 0;
+
+        // Allocated chunks belong to their owner, only free ones can be cleared behind its back.
+        cleared += clear_dirty(word, ~m_bitmap.word(word));
+    }
+    return cleared;
+}
+
+bool HeapRegion::contains(const void* ptr) const {
+    const auto address = reinterpret_cast<usize>(ptr);
+    return address >= m_data_start && address < m_data_start + data_size();
+}
+
+}
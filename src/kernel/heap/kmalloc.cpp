@@ -2,7 +2,6 @@
 // https://raw.githubusercontent.com/SerenityOS/serenity/1c692e87a647b26dc21825707b41b740a465a570/Kernel/Heap/kmalloc.cpp
 
 #include <kernel/heap/kmalloc.h>
-#include <kernel/util/interrupt_scope.h>
 #include <kernel/util/kassert.h>
 #include <kernel/util/kprintf.h>
 
@@ -10,160 +9,709 @@
 
 namespace Kernel {
 
-struct [[gnu::packed]] Block {
+// Sits right in front of every bitmap block. Its size keeps the payload 16 byte aligned, like slab objects.
+struct alignas(16) Block {
     usize start;
     usize chunk;
+    // Requested size, for the heap statistics.
+    usize size;
 };
 
-// Zero-initialize all new blocks.
-static constexpr bool ZERO_MEMORY = true;
-static constexpr bool LOG_ALLOCS = true;
+// Record every heap event in the allocation trace. Cheap enough to leave on, see AllocationTrace.
+static constexpr bool TRACE_ALLOCS = true;
 
-// The heap is split into chunks of this size.
-static constexpr usize CHUNK_SIZE = 64;
-static constexpr usize POOL_SIZE = (10 * MiB);
-static constexpr usize BITMAP_SIZE = (POOL_SIZE / CHUNK_SIZE / 8);
-// 1 bit per chunk. 1 = allocated, 0 = free.
-static u8 bitmap[BITMAP_SIZE];
+static constexpr usize CHUNK_SIZE = HeapRegion::CHUNK_SIZE;
+static constexpr usize CHUNKS_PER_PAGE = HeapRegion::CHUNKS_PER_PAGE;
+// Size of the first region, committed in initialize(). Later regions are at least this big.
+static constexpr usize INITIAL_REGION_SIZE = 4 * MiB;
+// Dirty map words scrub() clears per lock acquisition, at most 16 KiB of memset.
+static constexpr usize SCRUB_WORDS_PER_LOCK = 8;
 
-void MemoryManager::initialize(u64 memory_start, u64 memory_size) {
-    kassert_msg(memory_size > POOL_SIZE, "Not enough memory for the heap");
-    // TODO Perhaps it would be smarter to continue with the maximum possible heap size
-    //      instead of crashing when asked for too much?
+static constexpr usize round_up_to_page(usize value) {
+    return (value + MemoryManager::PAGE_SIZE - 1) & ~(MemoryManager::PAGE_SIZE - 1);
+}
 
-    m_memory_start = memory_start;
-    m_memory_size = memory_size;
-    m_free = POOL_SIZE;
+// Number of chunks a bitmap block of the given size occupies, including its header.
+static constexpr usize chunks_for(usize size) {
+    return (size + sizeof(Block) + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
 
-    memset(bitmap, 0, BITMAP_SIZE);
-    memset(reinterpret_cast<void*>(m_memory_start), 0, POOL_SIZE);
+// Histogram bucket of an allocation: ceil(log2(size)), with everything up to the smallest slab class in one bucket.
+static usize size_bucket(usize size) {
+    if (size <= SlabAllocator::MIN_SIZE)
+        return static_cast<usize>(__builtin_ctz(SlabAllocator::MIN_SIZE));
+    const auto bucket = sizeof(unsigned long) * 8 - static_cast<usize>(__builtin_clzl(size - 1));
+    return bucket < HeapStats::BUCKETS ? bucket : HeapStats::BUCKETS - 1;
+}
+
+// Histogram bucket of a free run: floor(log2(chunks)).
+static usize run_bucket(usize chunks) {
+    const auto bucket = sizeof(unsigned long) * 8 - 1 - static_cast<usize>(__builtin_clzl(chunks));
+    return bucket < HeapStats::BUCKETS ? bucket : HeapStats::BUCKETS - 1;
+}
+
+constinit MemoryManager MemoryManager::s_instance;
+
+void MemoryManager::initialize(const MemoryMap& memory) {
+    m_pages.initialize(memory);
+    m_memory_size = static_cast<u64>(m_pages.total_pages()) * PAGE_SIZE;
+    m_committed = 0;
+    kassert_msg(m_memory_size >= INITIAL_REGION_SIZE, "Not enough memory for the heap");
+
+    m_region_count = 0;
+    memset(m_region_lookup, NO_REGION, sizeof(m_region_lookup));
+    m_allocated = 0;
+    m_free = 0;
+    memset(m_live_allocations, 0, sizeof(m_live_allocations));
+    m_block_bytes = 0;
+    m_block_requested = 0;
+    m_slab_span_bytes = 0;
+    m_slab_object_bytes = 0;
+    m_large_bytes = 0;
+    m_large.clear();
+    m_generation = 0;
+
+    const auto* initial_region = grow(INITIAL_REGION_SIZE);
+    kassert(initial_region);
 
     // TODO fix this stupid kprintf bug
-    kprintf("Heap initialized @ %p, ", memory_start);
-    kprintln("%dK configured @ %d byte chunks", POOL_SIZE / KiB, CHUNK_SIZE);
+    kprintf("Heap initialized @ %p, ", m_regions[0].base());
+    kprintf("%dK available in %d ranges, ", static_cast<usize>(m_memory_size / KiB), memory.count());
+    kprintln("%dK committed @ %d byte chunks", static_cast<usize>(m_regions[0].size() / KiB), CHUNK_SIZE);
 
     m_initialized = true;
 }
 
-void* MemoryManager::allocate(usize size) {
-    kassert_msg(m_initialized, "Memory manager not initialized yet");
+HeapRegion* MemoryManager::grow(usize min_size) {
+    if (__atomic_load_n(&m_region_count, __ATOMIC_ACQUIRE) == MAX_REGIONS)
+        return nullptr;
+
+    // Grow by at least as much as is already committed, so the number of regions stays logarithmic in the heap size.
+    auto min = round_up_to_page(min_size);
+    if (min < 2 * PAGE_SIZE)
+        min = 2 * PAGE_SIZE;
+    auto size = min < INITIAL_REGION_SIZE ? INITIAL_REGION_SIZE : min;
+    if (size < m_committed)
+        size = static_cast<usize>(m_committed);
+
+    // Settle for less if memory is too fragmented for the preferred size, but never for less than min_size.
+    auto base = m_pages.allocate_pages(size / PAGE_SIZE);
+    while (!base && size > min) {
+        size = size / 2 > min ? round_up_to_page(size / 2) : min;
+        base = m_pages.allocate_pages(size / PAGE_SIZE);
+    }
+    if (!base)
+        return nullptr;
+
+    // Nobody else can see the region yet, so its metadata is laid out without holding the lock.
+    // The data area is left alone, zeroed allocations clear the chunks they get as needed.
+    HeapRegion new_region;
+    new_region.initialize(base.value(), size);
+
+    HeapRegion* region = nullptr;
+    {
+        ScopedSpinlock lock(m_lock);
+        if (m_region_count < MAX_REGIONS) {
+            const auto index = m_region_count;
+            m_regions[index] = new_region;
+            // Publish the region only once it is in place, lock-free searches walk the regions up to the count.
+            __atomic_store_n(&m_region_count, index + 1, __ATOMIC_RELEASE);
+            register_region(index);
+
+            region = &m_regions[index];
+            m_committed += size;
+            m_free += region->data_size();
+            m_generation++;
+
+            if constexpr (TRACE_ALLOCS)
+                m_trace.record(AllocationEvent::Grow, reinterpret_cast<void*>(region->base()), size, 0, nullptr);
+        }
+    }
 
-    Kernel::InterruptScope _;
-    m_allocation_count++;
+    // Someone else took the last region slot in the meantime.
+    if (!region) {
+        m_pages.free_pages(base.value(), size / PAGE_SIZE);
+        return nullptr;
+    }
 
-    const auto real_size = size + sizeof(Block);
-    kassert_msg(m_free > real_size, "Ran out of memory. Oops!");
+    return region;
+}
 
-    auto chunks_needed = real_size / CHUNK_SIZE;
-    if (real_size % CHUNK_SIZE)
-        chunks_needed++;
+void MemoryManager::register_region(usize index) {
+    // Insert the region into the address order.
+    auto position = index;
+    while (position > 0 && m_regions[m_region_order[position - 1]].base() > m_regions[index].base()) {
+        m_region_order[position] = m_region_order[position - 1];
+        position--;
+    }
+    m_region_order[position] = static_cast<u8>(index);
+
+    // Positions have shifted, rebuild the lookup table. Going backwards leaves each granule with its lowest region.
+    memset(m_region_lookup, NO_REGION, sizeof(m_region_lookup));
+    for (auto i = m_region_count; i > 0; i--) {
+        const auto& region = m_regions[m_region_order[i - 1]];
+        const auto first = region.base() / REGION_GRANULE;
+        const auto last = (region.base() + region.size() - 1) / REGION_GRANULE;
+        kassert(last < REGION_LOOKUP_SIZE);
+        for (auto granule = first; granule <= last; granule++)
+            m_region_lookup[granule] = static_cast<u8>(i - 1);
+    }
+}
 
-    if constexpr (LOG_ALLOCS)
-        kprintf("Allocating %d bytes (real %d bytes, %d chunks @ %d bytes)... ", size, real_size, chunks_needed, CHUNK_SIZE);
+template <typename Commit>
+MemoryManager::ChunkRun MemoryManager::allocate_chunks(usize chunks, usize alignment, usize offset, Commit commit) {
+    // Search the bitmaps with interrupts enabled, and only take the lock to claim the run that was found.
+    // An interrupt handler that takes the run first makes the claim fail, and every change to the bitmaps bumps the
+    // generation, so a search that came up empty is only trusted if nothing changed while it ran.
+    for (;;) {
+        const auto generation = __atomic_load_n(&m_generation, __ATOMIC_ACQUIRE);
+        const auto region_count = __atomic_load_n(&m_region_count, __ATOMIC_ACQUIRE);
+
+        for (usize i = 0; i < region_count; i++) {
+            auto& region = m_regions[i];
+            const auto first_chunk = region.find(chunks, alignment, offset);
+            if (!first_chunk)
+                continue;
 
-    const auto is_chunk_free = [](usize chunk, u8 bit) {
-        return (bitmap[chunk] & (1 << bit)) == 0;
-    };
+            ScopedSpinlock lock(m_lock);
+            if (!region.try_allocate_at(first_chunk.value(), chunks))
+                continue;
 
-    usize chunks_here = 0;
-    usize first_chunk = 0;
-    for (usize chunk = 0; chunk < BITMAP_SIZE; chunk++) {
-        if (bitmap[chunk] == 0xFF) {
-            chunks_here = 0;
-            continue;
+            m_generation++;
+            commit(region, first_chunk.value());
+            return { &region, first_chunk.value() };
         }
 
-        for (u8 bit = 0; bit < 8; bit++) {
-            if (!is_chunk_free(chunk, bit)) {
-                chunks_here = 0;
-                continue;
+        if (__atomic_load_n(&m_generation, __ATOMIC_ACQUIRE) == generation)
+            break;
+    }
+
+    // None of the existing regions has a large enough hole, commit a new one.
+    // Leave room for the metadata and for rounding the run up to the alignment.
+    const auto needed = chunks * CHUNK_SIZE + alignment;
+    auto* region = grow(needed + HeapRegion::metadata_size(needed));
+    if (!region)
+        return { nullptr, 0 };
+
+    // The new region is all but empty, so searching it under the lock is quick.
+    ScopedSpinlock lock(m_lock);
+    const auto first_chunk = region->allocate(chunks, alignment, offset);
+    if (!first_chunk)
+        return { nullptr, 0 };
+
+    m_generation++;
+    commit(*region, first_chunk.value());
+    return { region, first_chunk.value() };
+}
+
+void* MemoryManager::allocate(usize size) {
+    return allocate_block(size, false, __builtin_return_address(0));
+}
+
+void* MemoryManager::allocate_zeroed(usize size) {
+    return allocate_block(size, true, __builtin_return_address(0));
+}
+
+void* MemoryManager::allocate_block(usize size, bool zeroed, const void* caller) {
+    kassert_msg(m_initialized, "Memory manager not initialized yet");
+
+    if (size > LARGE_ALLOCATION_THRESHOLD) {
+        // The bitmap heap is the fallback when the table is full or no page run is left.
+        if (auto* pointer = allocate_large(size, zeroed, caller))
+            return pointer;
+    }
+
+    if (!SlabAllocator::handles(size))
+        return allocate_bitmap(size, zeroed, caller);
+
+    void* pointer;
+    for (;;) {
+        {
+            ScopedSpinlock lock(m_lock);
+            pointer = m_slab.allocate(size);
+            if (pointer) {
+                m_allocation_count++;
+                m_live_allocations[size_bucket(size)]++;
+                m_slab_object_bytes += SlabAllocator::object_size_for(size);
+
+                if constexpr (TRACE_ALLOCS)
+                    m_trace.record(AllocationEvent::Allocate, pointer, size, 0, caller);
+                break;
             }
+        }
 
-            if (chunks_here == 0)
-                first_chunk = chunk * 8 + bit;
-            chunks_here++;
+        // The size class is out of room. Get the pages for a new span without holding the lock, then try again.
+        auto* span = allocate_pages(SlabAllocator::span_pages(size));
+        kassert_msg(span, "MemoryManager: Out of memory.");
 
-            if (chunks_here == chunks_needed) {
-                auto* block = reinterpret_cast<Block*>(static_cast<usize>(m_memory_start) + (first_chunk * CHUNK_SIZE));
-                auto* pointer = reinterpret_cast<u8*>(block);
-                pointer += sizeof(Block);
-                block->chunk = chunks_needed;
-                block->start = first_chunk;
+        ScopedSpinlock lock(m_lock);
+        m_slab.add_span(size, span);
+    }
 
-                for (auto current_chunk = first_chunk; current_chunk < (first_chunk + chunks_needed); current_chunk++) {
-                    bitmap[current_chunk / 8] |= (1 << (current_chunk % 8));
-                }
+    // Slab objects are small and their free list links live inside them, so they are simply cleared.
+    if (zeroed)
+        memset(pointer, 0, size);
 
-                m_allocated += block->chunk * CHUNK_SIZE;
-                m_free -= block->chunk * CHUNK_SIZE;
+    return pointer;
+}
 
-                if constexpr (ZERO_MEMORY)
-                    memset(pointer, 0, size);
+void* MemoryManager::allocate_bitmap(usize size, bool zeroed, const void* caller) {
+    const auto chunks_needed = chunks_for(size);
+
+    u8* pointer = nullptr;
+    HeapRegion::ChunkRange dirty { 0, 0 };
+    const auto run = allocate_chunks(chunks_needed, CHUNK_SIZE, 0, [&](HeapRegion& region, usize first_chunk) {
+        // Only chunks that were used since they were last cleared have to be zeroed. The dirty map words are shared
+        // with the neighbouring chunks, so they are taken under the lock, but the clearing itself is left for later.
+        if (zeroed)
+            dirty = region.take_dirty(first_chunk, chunks_needed);
+
+        auto* block = reinterpret_cast<Block*>(region.chunk_address(first_chunk));
+        pointer = reinterpret_cast<u8*>(block) + sizeof(Block);
+        block->chunk = chunks_needed;
+        block->start = first_chunk;
+        block->size = size;
+
+        m_allocation_count++;
+        count_block(size, chunks_needed);
+
+        if constexpr (TRACE_ALLOCS)
+            m_trace.record(AllocationEvent::Allocate, pointer, size, chunks_needed, caller);
+    });
+
+    kassert_msg(pointer, "MemoryManager: Out of memory.");
+
+    // The run is claimed in the bitmap, so nothing else touches it now that interrupts are back on.
+    // The block header in front of the payload is already written and must not be cleared.
+    if (dirty.chunks) {
+        auto* start = run.region->chunk_address(dirty.first_chunk);
+        if (start < pointer)
+            start = pointer;
+        auto* end = run.region->chunk_address(dirty.first_chunk + dirty.chunks);
+        if (start < end)
+            memset(start, 0, static_cast<usize>(end - start));
+    }
 
-                if constexpr (LOG_ALLOCS)
-                    kprintln("%p", pointer);
+    return pointer;
+}
 
-                return pointer;
-            }
+void* MemoryManager::allocate_large(usize size, bool zeroed, const void* caller) {
+    if (m_large.is_full())
+        return nullptr;
+
+    // The page allocator has a lock of its own, so the heap lock is only needed to publish the allocation.
+    const auto pages = round_up_to_page(size) / PAGE_SIZE;
+    const auto address = m_pages.allocate_pages(pages);
+    if (!address)
+        return nullptr;
+
+    auto* pointer = reinterpret_cast<void*>(address.value());
+    bool inserted;
+    {
+        ScopedSpinlock lock(m_lock);
+        inserted = m_large.insert({ address.value(), pages, size });
+        if (inserted) {
+            m_allocation_count++;
+            m_allocated += pages * PAGE_SIZE;
+            m_large_bytes += pages * PAGE_SIZE;
+            m_live_allocations[size_bucket(size)]++;
+
+            if constexpr (TRACE_ALLOCS)
+                m_trace.record(AllocationEvent::Allocate, pointer, size, 0, caller);
         }
     }
 
-    kassert_msg(false, "MemoryManager: Out of memory.");
+    // The table filled up in the meantime.
+    if (!inserted) {
+        m_pages.free_pages(address.value(), pages);
+        return nullptr;
+    }
 
-    return nullptr;
+    // Pages come back from the page allocator as they were left, there is no dirty map for them.
+    if (zeroed)
+        memset(pointer, 0, size);
+
+    return pointer;
+}
+
+bool MemoryManager::expand_large(LargeAllocation& allocation, usize size, const void* caller) {
+    const auto pages = size ? round_up_to_page(size) / PAGE_SIZE : 1;
+    if (pages > allocation.pages)
+        return false;
+
+    // Shrinking, hand the trailing pages back.
+    if (const auto excess = allocation.pages - pages; excess != 0) {
+        m_pages.free_pages(allocation.address + pages * PAGE_SIZE, excess);
+        m_allocated -= excess * PAGE_SIZE;
+        m_large_bytes -= excess * PAGE_SIZE;
+    }
+
+    m_live_allocations[size_bucket(allocation.size)]--;
+    m_live_allocations[size_bucket(size)]++;
+    allocation.pages = pages;
+    allocation.size = size;
+
+    if constexpr (TRACE_ALLOCS)
+        m_trace.record(AllocationEvent::Resize, reinterpret_cast<void*>(allocation.address), size, 0, caller);
+    return true;
+}
+
+void MemoryManager::free_large(void* ptr, usize size, const void* caller) {
+    auto* allocation = m_large.find(ptr);
+    kassert_msg(allocation, "MemoryManager: Freeing an address that was never allocated");
+    kassert_msg(size <= allocation->pages * PAGE_SIZE, "MemoryManager: Sized free does not match the allocation");
+
+    if constexpr (TRACE_ALLOCS)
+        m_trace.record(AllocationEvent::Free, ptr, allocation->size, 0, caller);
+
+    m_pages.free_pages(allocation->address, allocation->pages);
+    m_allocated -= allocation->pages * PAGE_SIZE;
+    m_large_bytes -= allocation->pages * PAGE_SIZE;
+    m_live_allocations[size_bucket(allocation->size)]--;
+    m_large.remove(allocation);
+}
+
+void* MemoryManager::allocate_pages(usize count) {
+    const auto run = allocate_chunks(count * CHUNKS_PER_PAGE, PAGE_SIZE, 0, [&](HeapRegion& region, usize first_chunk) {
+        const auto first_page = first_chunk / CHUNKS_PER_PAGE;
+        for (usize i = 0; i < count; i++)
+            region.set_page_owner(first_page + i, static_cast<u8>(i + 1));
+
+        m_allocated += count * PAGE_SIZE;
+        m_free -= count * PAGE_SIZE;
+        // Slab spans are the only users of page runs.
+        m_slab_span_bytes += count * PAGE_SIZE;
+    });
+
+    if (!run.region)
+        return nullptr;
+    return run.region->chunk_address(run.first_chunk);
+}
+
+void MemoryManager::free_pages(void* ptr, usize count) {
+    auto* region = region_for(ptr);
+    const auto first_page = region->page_index(ptr);
+
+    region->free(first_page * CHUNKS_PER_PAGE, count * CHUNKS_PER_PAGE);
+    for (usize i = 0; i < count; i++)
+        region->set_page_owner(first_page + i, 0);
+
+    m_allocated -= count * PAGE_SIZE;
+    m_free += count * PAGE_SIZE;
+    m_slab_span_bytes -= count * PAGE_SIZE;
+    m_generation++;
 }
 
 void* MemoryManager::allocate_aligned(usize size, usize alignment) {
-    auto* ptr = kmalloc(size + alignment + sizeof(void*));
-    const auto max_addr = reinterpret_cast<usize>(ptr) + alignment;
-    auto* aligned_ptr = reinterpret_cast<void*>(max_addr - (max_addr % alignment));
-    reinterpret_cast<void**>(aligned_ptr)[-1] = ptr;
-    return aligned_ptr;
+    kassert_msg((alignment & (alignment - 1)) == 0, "Alignment has to be a power of two");
+
+    const auto* caller = __builtin_return_address(0);
+
+    // Bitmap blocks and slab objects are both 16 byte aligned already.
+    if (alignment <= 16)
+        return allocate_block(size, false, caller);
+
+    kassert_msg(m_initialized, "Memory manager not initialized yet");
+
+    // Page runs are aligned well enough for anything up to a page.
+    if (size > LARGE_ALLOCATION_THRESHOLD && alignment <= PAGE_SIZE) {
+        if (auto* pointer = allocate_large(size, false, caller))
+            return pointer;
+    }
+
+    // The payload starts at the second chunk of the run, with the block header in the last bytes of the first one.
+    // That way the search only has to find a run whose second chunk is aligned, and free() finds the header as usual.
+    // Zero-sized blocks still get a payload chunk, or the pointer would lie past the end of the run.
+    const auto chunks_needed = 1 + (size ? (size + CHUNK_SIZE - 1) / CHUNK_SIZE : 1);
+
+    u8* pointer = nullptr;
+    allocate_chunks(chunks_needed, alignment < CHUNK_SIZE ? CHUNK_SIZE : alignment, CHUNK_SIZE, [&](HeapRegion& region, usize first_chunk) {
+        pointer = region.chunk_address(first_chunk + 1);
+        auto* block = reinterpret_cast<Block*>(pointer - sizeof(Block));
+        block->chunk = chunks_needed;
+        block->start = first_chunk;
+        block->size = size;
+
+        m_allocation_count++;
+        count_block(size, chunks_needed);
+
+        if constexpr (TRACE_ALLOCS)
+            m_trace.record(AllocationEvent::Allocate, pointer, size, chunks_needed, caller);
+    });
+
+    kassert_msg(pointer, "MemoryManager: Out of memory.");
+    return pointer;
 }
 
-void MemoryManager::free(void* ptr) {
+void* MemoryManager::reallocate(void* ptr, usize size) {
+    const auto* caller = __builtin_return_address(0);
     if (!ptr)
-        return;
+        return allocate_block(size, false, caller);
 
+    if (expand(ptr, size, caller))
+        return ptr;
+
+    auto* new_ptr = allocate_block(size, false, caller);
+    const auto old_size = usable_size(ptr);
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    free_block(ptr, 0, caller);
+    return new_ptr;
+}
+
+bool MemoryManager::try_expand(void* ptr, usize size) {
+    return expand(ptr, size, __builtin_return_address(0));
+}
+
+bool MemoryManager::expand(void* ptr, usize size, const void* caller) {
+    ScopedSpinlock lock(m_lock);
     kassert(is_kmalloc_address(ptr));
 
-    Kernel::InterruptScope _;
+    auto* region = region_for(ptr);
+    if (!region)
+        return expand_large(*m_large.find(ptr), size, caller);
+
+    if (const auto* span = slab_span_for(*region, ptr)) {
+        if (size > SlabAllocator::object_size(span))
+            return false;
+        if constexpr (TRACE_ALLOCS)
+            m_trace.record(AllocationEvent::Resize, ptr, size, 0, caller);
+        return true;
+    }
+
+    auto* block = reinterpret_cast<Block*>(reinterpret_cast<usize>(ptr) - sizeof(Block));
+    // Aligned blocks don't start right at their first chunk, so count from where the run begins.
+    const auto offset = reinterpret_cast<usize>(ptr) - reinterpret_cast<usize>(region->chunk_address(block->start));
+    // Never give back the chunk ptr points into, even when shrinking to zero bytes.
+    const auto chunks_needed = (offset + (size ? size : 1) + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    if (chunks_needed <= block->chunk) {
+        // Shrinking, hand the trailing chunks back.
+        if (const auto excess = block->chunk - chunks_needed; excess != 0)
+            region->free(block->start + chunks_needed, excess);
+    } else if (!region->try_allocate_at(block->start + block->chunk, chunks_needed - block->chunk)) {
+        return false;
+    }
+
+    uncount_block(block->size, block->chunk);
+    block->chunk = chunks_needed;
+    block->size = size;
+    count_block(size, chunks_needed);
+    m_generation++;
+
+    if constexpr (TRACE_ALLOCS)
+        m_trace.record(AllocationEvent::Resize, ptr, size, chunks_needed, caller);
+    return true;
+}
+
+usize MemoryManager::usable_size(const void* ptr) {
+    ScopedSpinlock lock(m_lock);
+
+    const auto* region = region_for(ptr);
+    if (!region)
+        return m_large.find(ptr)->pages * PAGE_SIZE;
+
+    if (const auto* span = slab_span_for(*region, ptr))
+        return SlabAllocator::object_size(span);
+
+    const auto* block = reinterpret_cast<const Block*>(reinterpret_cast<usize>(ptr) - sizeof(Block));
+    const auto end = reinterpret_cast<usize>(region->chunk_address(block->start + block->chunk));
+    return end - reinterpret_cast<usize>(ptr);
+}
+
+void MemoryManager::free(void* ptr) {
+    free_block(ptr, 0, __builtin_return_address(0));
+}
+
+void MemoryManager::free(void* ptr, usize size) {
+    free_block(ptr, size, __builtin_return_address(0));
+}
+
+void MemoryManager::free_block(void* ptr, usize size, const void* caller) {
+    if (!ptr)
+        return;
+
+    ScopedSpinlock lock(m_lock);
     m_free_count++;
 
-    const auto* block = reinterpret_cast<Block*>(reinterpret_cast<usize>(ptr) - sizeof(Block));
+    // Large allocations live outside of the regions.
+    auto* region = region_for(ptr);
+    if (!region) {
+        free_large(ptr, size, caller);
+        return;
+    }
+
+    if (auto* span = slab_span_for(*region, ptr)) {
+        const auto object_size = SlabAllocator::object_size(span);
+        kassert_msg(size <= object_size, "MemoryManager: Sized free does not match the allocation");
 
-    for (auto i = block->start; i < block->start + block->chunk; i++) {
-        bitmap[i / 8] &= static_cast<u8>(~(1 << (i % 8)));
+        m_live_allocations[size_bucket(object_size)]--;
+        m_slab_object_bytes -= object_size;
+
+        if constexpr (TRACE_ALLOCS)
+            m_trace.record(AllocationEvent::Free, ptr, object_size, 0, caller);
+        m_slab.free(span, ptr);
+        return;
     }
 
-    m_allocated -= block->chunk * CHUNK_SIZE;
-    m_free += block->chunk * CHUNK_SIZE;
+    free_bitmap(*region, ptr, caller);
+}
+
+void MemoryManager::free_bitmap(HeapRegion& region, void* ptr, const void* caller) {
+    const auto* block = reinterpret_cast<Block*>(reinterpret_cast<usize>(ptr) - sizeof(Block));
+
+    if constexpr (TRACE_ALLOCS)
+        m_trace.record(AllocationEvent::Free, ptr, block->size, block->chunk, caller);
+
+    region.free(block->start, block->chunk);
+    uncount_block(block->size, block->chunk);
+    m_generation++;
+}
+
+void MemoryManager::count_block(usize size, usize chunks) {
+    m_allocated += chunks * CHUNK_SIZE;
+    m_free -= chunks * CHUNK_SIZE;
+    m_live_allocations[size_bucket(size)]++;
+    m_block_bytes += chunks * CHUNK_SIZE;
+    m_block_requested += size;
 }
 
-void MemoryManager::free_aligned(void* ptr) {
-    kfree((reinterpret_cast<void**>(ptr))[-1]);
+void MemoryManager::uncount_block(usize size, usize chunks) {
+    m_allocated -= chunks * CHUNK_SIZE;
+    m_free += chunks * CHUNK_SIZE;
+    m_live_allocations[size_bucket(size)]--;
+    m_block_bytes -= chunks * CHUNK_SIZE;
+    m_block_requested -= size;
 }
 
 bool MemoryManager::is_kmalloc_address(const void* ptr) {
-    const auto pointer = reinterpret_cast<usize>(ptr);
-    const auto memory_start = static_cast<usize>(m_memory_start);
-    return pointer >= memory_start && pointer <= memory_start + POOL_SIZE;
+    return region_for(ptr) != nullptr || m_large.find(ptr) != nullptr;
+}
+
+HeapRegion* MemoryManager::region_for(const void* ptr) {
+    const auto granule = reinterpret_cast<usize>(ptr) / REGION_GRANULE;
+    if (granule >= REGION_LOOKUP_SIZE)
+        return nullptr;
+
+    const auto first = m_region_lookup[granule];
+    if (first == NO_REGION)
+        return nullptr;
+
+    for (usize position = first; position < m_region_count; position++) {
+        auto& region = m_regions[m_region_order[position]];
+        if (region.contains(ptr))
+            return &region;
+        if (region.base() > reinterpret_cast<usize>(ptr))
+            break;
+    }
+    return nullptr;
+}
+
+SlabSpan* MemoryManager::slab_span_for(const HeapRegion& region, const void* ptr) {
+    // The page map doubles as the span lookup table: slab pages store their distance from the span start.
+    const auto page = region.page_index(ptr);
+    const auto offset = region.page_owner(page);
+    if (offset == 0)
+        return nullptr;
+    return reinterpret_cast<SlabSpan*>(region.data_start() + (page - (offset - 1)) * PAGE_SIZE);
+}
+
+usize MemoryManager::scrub(usize max_bytes) {
+    kassert_msg(m_initialized, "Memory manager not initialized yet");
+
+    const auto max_chunks = max_bytes / CHUNK_SIZE;
+    const auto region_count = __atomic_load_n(&m_region_count, __ATOMIC_ACQUIRE);
+    usize cleared = 0;
+
+    // Work through the dirty maps a few words at a time, so interrupts are never held off for long.
+    for (usize i = 0; i < region_count && cleared < max_chunks; i++) {
+        auto& region = m_regions[i];
+        for (usize visited = 0; visited < region.scrub_words() && cleared < max_chunks; visited += SCRUB_WORDS_PER_LOCK) {
+            ScopedSpinlock lock(m_lock);
+            cleared += region.scrub(max_chunks - cleared, SCRUB_WORDS_PER_LOCK);
+        }
+    }
+    return cleared * CHUNK_SIZE;
+}
+
+HeapStats MemoryManager::stats() {
+    HeapStats stats {};
+
+    // Walking the bitmaps takes a while, so the lock is only held for one region at a time.
+    const auto region_count = __atomic_load_n(&m_region_count, __ATOMIC_ACQUIRE);
+    for (usize i = 0; i < region_count; i++) {
+        ScopedSpinlock lock(m_lock);
+
+        const auto& region = m_regions[i];
+        stats.committed += region.data_size();
+        stats.free += region.free_chunks() * CHUNK_SIZE;
+
+        region.for_each_free_run([&](usize, usize chunks) {
+            stats.free_runs[run_bucket(chunks)]++;
+            if (chunks * CHUNK_SIZE > stats.largest_free_run)
+                stats.largest_free_run = chunks * CHUNK_SIZE;
+        });
+    }
+
+    ScopedSpinlock lock(m_lock);
+    stats.regions = region_count;
+    stats.reserve = m_pages.free_page_count() * PAGE_SIZE;
+    memcpy(stats.live_allocations, m_live_allocations, sizeof(m_live_allocations));
+    stats.block_bytes = m_block_bytes;
+    stats.block_requested = m_block_requested;
+    stats.slab_span_bytes = m_slab_span_bytes;
+    stats.slab_object_bytes = m_slab_object_bytes;
+    stats.large_allocations = m_large.count();
+    stats.large_bytes = m_large_bytes;
+    stats.max_irq_off_cycles = m_lock.max_hold_cycles();
+    return stats;
+}
+
+void HeapStats::print() const {
+    kprintf("Heap: %d regions, ", regions);
+    kprintf("%dK committed, ", committed / KiB);
+    kprintf("%dK free, ", free / KiB);
+    kprintln("%dK in reserve", reserve / KiB);
+    kprintf("Largest free run %dK, ", largest_free_run / KiB);
+    kprintln("%d%% external fragmentation", external_fragmentation());
+    kprintf("Blocks: %dK in chunks, ", block_bytes / KiB);
+    kprintf("%dK requested, ", block_requested / KiB);
+    kprintln("%d bytes lost to headers and rounding", internal_fragmentation());
+    kprintf("Slabs: %dK in spans, ", slab_span_bytes / KiB);
+    kprintln("%dK in live objects", slab_object_bytes / KiB);
+    kprintf("Large: %d allocations, ", large_allocations);
+    kprintln("%dK in page runs", large_bytes / KiB);
+    kprintln("Longest IRQ-off section: %d cycles", static_cast<usize>(max_irq_off_cycles));
+
+    kprintln("Free runs (chunks):");
+    for (usize i = 0; i < BUCKETS; i++) {
+        if (free_runs[i])
+            kprintln("  %d+: %d", static_cast<usize>(1) << i, free_runs[i]);
+    }
+    kprintln("Live allocations (bytes):");
+    for (usize i = 0; i < BUCKETS; i++) {
+        if (live_allocations[i])
+            kprintln("  <=%d: %d", static_cast<usize>(1) << i, live_allocations[i]);
+    }
 }
 
 u64 MemoryManager::allocations() const { return m_allocation_count; }
 u64 MemoryManager::frees() const { return m_free_count; }
 u64 MemoryManager::allocated() const { return m_allocated; }
-u64 MemoryManager::available() const { return m_free; }
-u64 MemoryManager::total() const { return POOL_SIZE; }
+u64 MemoryManager::available() const { return m_free + static_cast<u64>(m_pages.free_page_count()) * PAGE_SIZE; }
+u64 MemoryManager::total() const { return m_memory_size; }
 
 }
 
 void* kmalloc(usize size) { return Kernel::MemoryManager::get().allocate(size); }
+void* kzalloc(usize size) { return Kernel::MemoryManager::get().allocate_zeroed(size); }
+void* kmalloc_aligned(usize size, usize alignment) { return Kernel::MemoryManager::get().allocate_aligned(size, alignment); }
+void* krealloc(void* ptr, usize size) { return Kernel::MemoryManager::get().reallocate(ptr, size); }
 void kfree(void* ptr) { Kernel::MemoryManager::get().free(ptr); }
+void kfree_sized(void* ptr, usize size) { Kernel::MemoryManager::get().free(ptr, size); }
 
 void* operator new(usize size) { return kmalloc(size); }
 void* operator new[](usize size) { return kmalloc(size); }
 void operator delete(void* ptr) { kfree(ptr); }
 void operator delete[](void* ptr) { kfree(ptr); }
-void operator delete(void* ptr, usize) { kfree(ptr); }
+void operator delete(void* ptr, usize size) { kfree_sized(ptr, size); }
 void operator delete[](void* ptr, usize) { kfree(ptr); }
@@ -0,0 +1,68 @@
+#include <kernel/heap/large_allocation_table.h>
+#include <kernel/heap/page_allocator.h>
+#include <kernel/util/kassert.h>
+
+#include <libc/string.h>
+
+namespace Kernel {
+
+static_assert((LargeAllocationTable::CAPACITY & (LargeAllocationTable::CAPACITY - 1)) == 0);
+
+void LargeAllocationTable::clear() {
+    memset(m_entries, 0, sizeof(m_entries));
+    m_count = 0;
+}
+
+usize LargeAllocationTable::slot_for(usize address) {
+    // Fibonacci hashing of the page number, the low address bits are always zero.
+    const auto hash = static_cast<u32>(address / PageAllocator::PAGE_SIZE) * 2654435769u;
+    return hash >> (32 - __builtin_ctz(CAPACITY));
+}
+
+bool LargeAllocationTable::insert(const LargeAllocation& allocation) {
+    kassert(allocation.address != 0);
+    if (is_full())
+        return false;
+
+    auto slot = slot_for(allocation.address);
+    while (m_entries[slot].address != 0)
+        slot = (slot + 1) & (CAPACITY - 1);
+
+    m_entries[slot] = allocation;
+    m_count++;
+    return true;
+}
+
+LargeAllocation* LargeAllocationTable::find(const void* ptr) {
+    const auto address = reinterpret_cast<usize>(ptr);
+    if (address == 0)
+        return nullptr;
+
+    for (auto slot = slot_for(address); m_entries[slot].address != 0; slot = (slot + 1) & (CAPACITY - 1)) {
+        if (m_entries[slot].address == address)
+            return &m_entries[slot];
+    }
+    return nullptr;
+}
+
+void LargeAllocationTable::remove(LargeAllocation* entry) {
+    auto hole = static_cast<usize>(entry - m_entries);
+    kassert(hole < CAPACITY && entry->address != 0);
+
+    // Shift later entries of the probe sequence back into the hole, so lookups never stop at it early.
+    for (auto slot = (hole + 1) & (CAPACITY - 1); m_entries[slot].address != 0; slot = (slot + 1) & (CAPACITY - 1)) {
+        const auto home = slot_for(m_entries[slot].address);
+        // Entries whose home slot lies cyclically in (hole, slot] are already reachable and stay where they are.
+        const auto reachable = hole <= slot ? (hole < home && home <= slot) : (hole < home || home <= slot);
+        if (reachable)
+            continue;
+
+        m_entries[hole] = m_entries[slot];
+        hole = slot;
+    }
+
+    m_entries[hole] = {};
+    m_count--;
+}
+
+}
@@ -0,0 +1,109 @@
+#include <kernel/heap/memory_map.h>
+#include <kernel/util/kassert.h>
+
+namespace Kernel {
+
+void MemoryMap::add(u64 start, u64 size) {
+    if (size == 0)
+        return;
+
+    auto end = start + size;
+
+    // Find the first range that ends at or after the new one starts, everything before it stays untouched.
+    usize index = 0;
+    while (index < m_count && m_ranges[index].end() < start)
+        index++;
+
+    // Swallow every range that overlaps or touches the new one.
+    while (index < m_count && m_ranges[index].start <= end) {
+        const auto& other = m_ranges[index];
+        if (other.start < start)
+            start = other.start;
+        if (other.end() > end)
+            end = other.end();
+        remove_at(index);
+    }
+
+    insert_at(index, { start, end - start });
+}
+
+void MemoryMap::reserve(u64 start, u64 size) {
+    if (size == 0)
+        return;
+
+    const auto end = start + size;
+    for (usize i = 0; i < m_count;) {
+        const auto range = m_ranges[i];
+        if (range.end() <= start || range.start >= end) {
+            i++;
+            continue;
+        }
+
+        remove_at(i);
+        // Put back whatever is left on either side of the reserved area.
+        if (range.start < start)
+            insert_at(i++, { range.start, start - range.start });
+        if (range.end() > end)
+            insert_at(i++, { end, range.end() - end });
+    }
+}
+
+void MemoryMap::trim(u64 limit, usize page_size) {
+    for (usize i = 0; i < m_count;) {
+        auto& range = m_ranges[i];
+        const auto start = (range.start + page_size - 1) & ~static_cast<u64>(page_size - 1);
+        auto end = range.end() < limit ? range.end() : limit;
+        end &= ~static_cast<u64>(page_size - 1);
+
+        if (end <= start) {
+            remove_at(i);
+            continue;
+        }
+
+        range = { start, end - start };
+        i++;
+    }
+}
+
+Optional<MemoryRange> MemoryMap::take(u64 min_size, u64 preferred_size) {
+    usize chosen = m_count;
+    for (usize i = 0; i < m_count; i++) {
+        if (m_ranges[i].size >= preferred_size) {
+            chosen = i;
+            break;
+        }
+        if (chosen == m_count || m_ranges[i].size > m_ranges[chosen].size)
+            chosen = i;
+    }
+
+    if (chosen == m_count || m_ranges[chosen].size < min_size)
+        return Optional<MemoryRange>::empty();
+
+    auto& range = m_ranges[chosen];
+    const auto size = range.size < preferred_size ? range.size : preferred_size;
+    const auto taken = MemoryRange { range.start, size };
+
+    range.start += size;
+    range.size -= size;
+    if (range.size == 0)
+        remove_at(chosen);
+
+    return taken;
+}
+
+void MemoryMap::insert_at(usize index, MemoryRange range) {
+    kassert_msg(m_count < MAX_RANGES, "MemoryMap: Too many ranges");
+
+    for (auto i = m_count; i > index; i--)
+        m_ranges[i] = m_ranges[i - 1];
+    m_ranges[index] = range;
+    m_count++;
+}
+
+void MemoryMap::remove_at(usize index) {
+    for (auto i = index; i + 1 < m_count; i++)
+        m_ranges[i] = m_ranges[i + 1];
+    m_count--;
+}
+
+}
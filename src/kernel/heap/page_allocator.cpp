@@ -0,0 +1,234 @@
+#include <kernel/heap/page_allocator.h>
+#include <kernel/util/kassert.h>
+#include <kernel/util/kprintf.h>
+
+#include <libc/string.h>
+
+namespace Kernel {
+
+struct FreePageBlock {
+    FreePageBlock* next;
+    FreePageBlock* prev;
+};
+
+static constexpr usize MAX_BLOCK_PAGES = static_cast<usize>(1) << PageAllocator::MAX_ORDER;
+
+static FreePageBlock* block_at(usize frame) {
+    return reinterpret_cast<FreePageBlock*>(frame * PageAllocator::PAGE_SIZE);
+}
+
+static usize frame_of(const FreePageBlock* block) {
+    return reinterpret_cast<usize>(block) / PageAllocator::PAGE_SIZE;
+}
+
+void PageAllocator::initialize(const MemoryMap& memory) {
+    kassert_msg(memory.count() != 0, "PageAllocator: No memory");
+
+    auto map = memory;
+    m_first_frame = static_cast<usize>(map.range(0).start / PAGE_SIZE);
+    m_frame_count = static_cast<usize>(map.range(map.count() - 1).end() / PAGE_SIZE) - m_first_frame;
+
+    // The frame table spans every frame from the lowest to the highest one, holes included.
+    const auto table_size = (m_frame_count + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    const auto table = map.take(table_size, table_size);
+    kassert_msg(table, "PageAllocator: No room for the frame table");
+    m_frame_orders = reinterpret_cast<u8*>(static_cast<usize>(table.value().start));
+    memset(m_frame_orders, 0, m_frame_count);
+
+    memset(m_free_lists, 0, sizeof(m_free_lists));
+    memset(m_free_blocks, 0, sizeof(m_free_blocks));
+    memset(m_allocations, 0, sizeof(m_allocations));
+    m_free_pages = 0;
+
+    for (usize i = 0; i < map.count(); i++) {
+        const auto& range = map.range(i);
+        release_range(static_cast<usize>(range.start / PAGE_SIZE), static_cast<usize>(range.size / PAGE_SIZE));
+    }
+
+    m_total_pages = m_free_pages;
+    m_splits = 0;
+    m_merges = 0;
+}
+
+Optional<usize> PageAllocator::allocate(usize order) {
+    kassert(order <= MAX_ORDER);
+
+    ScopedSpinlock lock(m_lock);
+
+    const auto frame = take_block(order);
+    if (!frame)
+        return Optional<usize>::empty();
+
+    m_allocations[order]++;
+    return frame.value() * PAGE_SIZE;
+}
+
+void PageAllocator::free(usize address, usize order) {
+    kassert(order <= MAX_ORDER);
+    kassert_msg((address & ((PAGE_SIZE << order) - 1)) == 0, "PageAllocator: Block is not aligned to its order");
+
+    ScopedSpinlock lock(m_lock);
+    release(address / PAGE_SIZE, order);
+}
+
+Optional<usize> PageAllocator::allocate_pages(usize count) {
+    if (count == 0)
+        count = 1;
+
+    ScopedSpinlock lock(m_lock);
+
+    const auto order = order_for(count);
+    const auto blocks = (count + MAX_BLOCK_PAGES - 1) / MAX_BLOCK_PAGES;
+    const auto frame = order <= MAX_ORDER ? take_block(order) : take_contiguous(blocks);
+    if (!frame)
+        return Optional<usize>::empty();
+
+    m_allocations[order <= MAX_ORDER ? order : MAX_ORDER]++;
+
+    // Hand the pages past the end of the run straight back.
+    const auto taken = order <= MAX_ORDER ? static_cast<usize>(1) << order : blocks * MAX_BLOCK_PAGES;
+    release_range(frame.value() + count, taken - count);
+
+    return frame.value() * PAGE_SIZE;
+}
+
+void PageAllocator::free_pages(usize address, usize count) {
+    kassert_msg((address & (PAGE_SIZE - 1)) == 0, "PageAllocator: Address is not page aligned");
+
+    ScopedSpinlock lock(m_lock);
+    release_range(address / PAGE_SIZE, count);
+}
+
+usize PageAllocator::order_for(usize pages) {
+    if (pages <= 1)
+        return 0;
+    return sizeof(unsigned long) * 8 - static_cast<usize>(__builtin_clzl(pages - 1));
+}
+
+Optional<usize> PageAllocator::take_block(usize order) {
+    auto current = order;
+    while (current <= MAX_ORDER && !m_free_lists[current])
+        current++;
+    if (current > MAX_ORDER)
+        return Optional<usize>::empty();
+
+    const auto frame = frame_of(m_free_lists[current]);
+    unlink(frame, current);
+
+    // Split the block down to the requested order, freeing the upper half every time.
+    while (current > order) {
+        current--;
+        push(frame + (static_cast<usize>(1) << current), current);
+        m_splits++;
+    }
+    return frame;
+}
+
+Optional<usize> PageAllocator::take_contiguous(usize blocks) {
+    for (auto* block = m_free_lists[MAX_ORDER]; block; block = block->next) {
+        const auto first = frame_of(block);
+
+        usize found = 1;
+        while (found < blocks && is_free_block(first + found * MAX_BLOCK_PAGES, MAX_ORDER))
+            found++;
+        if (found < blocks)
+            continue;
+
+        for (usize i = 0; i < blocks; i++)
+            unlink(first + i * MAX_BLOCK_PAGES, MAX_ORDER);
+        return first;
+    }
+    return Optional<usize>::empty();
+}
+
+void PageAllocator::release(usize frame, usize order) {
+    while (order < MAX_ORDER) {
+        const auto buddy = frame ^ (static_cast<usize>(1) << order);
+        if (!is_free_block(buddy, order))
+            break;
+
+        unlink(buddy, order);
+        // The merged block starts at whichever of the two comes first.
+        frame &= ~(static_cast<usize>(1) << order);
+        order++;
+        m_merges++;
+    }
+    push(frame, order);
+}
+
+void PageAllocator::release_range(usize frame, usize count) {
+    const auto end = frame + count;
+    while (frame < end) {
+        // Free the largest block that starts here, is aligned to its size and fits into the range.
+        auto order = MAX_ORDER;
+        while (order > 0 && ((frame & ((static_cast<usize>(1) << order) - 1)) != 0 || frame + (static_cast<usize>(1) << order) > end))
+            order--;
+
+        release(frame, order);
+        frame += static_cast<usize>(1) << order;
+    }
+}
+
+void PageAllocator::push(usize frame, usize order) {
+    auto* block = block_at(frame);
+    block->prev = nullptr;
+    block->next = m_free_lists[order];
+    if (block->next)
+        block->next->prev = block;
+    m_free_lists[order] = block;
+
+    m_frame_orders[frame - m_first_frame] = static_cast<u8>(order + 1);
+    m_free_blocks[order]++;
+    m_free_pages += static_cast<usize>(1) << order;
+}
+
+void PageAllocator::unlink(usize frame, usize order) {
+    auto* block = block_at(frame);
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        m_free_lists[order] = block->next;
+    if (block->next)
+        block->next->prev = block->prev;
+
+    m_frame_orders[frame - m_first_frame] = 0;
+    m_free_blocks[order]--;
+    m_free_pages -= static_cast<usize>(1) << order;
+}
+
+bool PageAllocator::is_free_block(usize frame, usize order) const {
+    if (frame < m_first_frame || frame - m_first_frame >= m_frame_count)
+        return false;
+    return m_frame_orders[frame - m_first_frame] == order + 1;
+}
+
+PageAllocator::Stats PageAllocator::stats() const {
+    Stats stats {};
+
+    ScopedSpinlock lock(m_lock);
+
+    stats.total_pages = m_total_pages;
+    stats.free_pages = m_free_pages;
+    memcpy(stats.free_blocks, m_free_blocks, sizeof(m_free_blocks));
+    memcpy(stats.allocations, m_allocations, sizeof(m_allocations));
+    stats.splits = m_splits;
+    stats.merges = m_merges;
+    stats.max_irq_off_cycles = m_lock.max_hold_cycles();
+    return stats;
+}
+
+void PageAllocator::Stats::print() const {
+    kprintf("Pages: %dK free ", free_pages * PAGE_SIZE / KiB);
+    kprintf("of %dK, ", total_pages * PAGE_SIZE / KiB);
+    kprintf("%d splits, ", splits);
+    kprintf("%d merges, ", merges);
+    kprintln("longest IRQ-off section %d cycles", static_cast<usize>(max_irq_off_cycles));
+
+    kprintln("Blocks per order (free/allocated):");
+    for (usize order = 0; order < ORDER_COUNT; order++) {
+        if (free_blocks[order] || allocations[order])
+            kprintln("  %dK: %d/%d", (PAGE_SIZE << order) / KiB, free_blocks[order], allocations[order]);
+    }
+}
+
+}
@@ -0,0 +1,143 @@
+#include <kernel/heap/kmalloc.h>
+#include <kernel/heap/slab.h>
+#include <kernel/util/kassert.h>
+
+namespace Kernel {
+
+struct FreeObject {
+    FreeObject* next;
+};
+
+// Lives at the start of every span, followed by the objects themselves.
+struct SlabSpan {
+    SlabSpan* next;
+    SlabSpan* prev;
+    // Objects that were handed out and freed again.
+    FreeObject* free_list;
+    // Objects past this pointer have never been handed out. Carving them lazily keeps span creation O(1).
+    u8* bump;
+    u16 used;
+    u16 capacity;
+    u8 size_class;
+    u8 pages;
+};
+
+// Keep objects 16-byte aligned.
+static constexpr usize SPAN_HEADER_SIZE = (sizeof(SlabSpan) + 15) & ~static_cast<usize>(15);
+
+usize SlabAllocator::size_class_for(usize size) {
+    usize size_class = 0;
+    while (class_size(size_class) < size)
+        size_class++;
+    return size_class;
+}
+
+usize SlabAllocator::span_pages_for(usize size_class) {
+    // Give the bigger classes more room, so the span header doesn't eat half of a page.
+    // 1024 and 2048 byte objects get 7 per span, everything else at least that many.
+    const auto size = class_size(size_class);
+    if (size <= 512)
+        return 1;
+    return size * 8 / MemoryManager::PAGE_SIZE;
+}
+
+usize SlabAllocator::object_size(const SlabSpan* span) {
+    return class_size(span->size_class);
+}
+
+void* SlabAllocator::allocate(usize size) {
+    kassert(handles(size));
+
+    const auto size_class = size_class_for(size);
+    auto& sc = m_classes[size_class];
+
+    auto* span = sc.partial;
+    if (!span) {
+        if (!sc.spare)
+            return nullptr;
+        span = sc.spare;
+        sc.spare = nullptr;
+        push_front(sc, span);
+    }
+
+    void* object;
+    if (span->free_list) {
+        object = span->free_list;
+        span->free_list = span->free_list->next;
+    } else {
+        object = span->bump;
+        span->bump += class_size(size_class);
+    }
+
+    if (++span->used == span->capacity)
+        unlink(sc, span);
+
+    return object;
+}
+
+void SlabAllocator::free(SlabSpan* span, void* ptr) {
+    auto& sc = m_classes[span->size_class];
+
+    const auto was_full = span->used == span->capacity;
+
+    auto* object = static_cast<FreeObject*>(ptr);
+    object->next = span->free_list;
+    span->free_list = object;
+    span->used--;
+
+    if (was_full)
+        push_front(sc, span);
+
+    if (span->used != 0)
+        return;
+
+    // The span is completely free now. Keep one around per class, give the rest back to the heap.
+    unlink(sc, span);
+    if (!sc.spare) {
+        sc.spare = span;
+        return;
+    }
+    MemoryManager::get().free_pages(span, span->pages);
+}
+
+void SlabAllocator::add_span(usize size, void* memory) {
+    const auto size_class = size_class_for(size);
+    push_front(m_classes[size_class], create_span(size_class, static_cast<u8*>(memory)));
+}
+
+SlabSpan* SlabAllocator::create_span(usize size_class, u8* memory) {
+    const auto pages = span_pages_for(size_class);
+    const auto span_size = pages * MemoryManager::PAGE_SIZE;
+
+    auto* span = reinterpret_cast<SlabSpan*>(memory);
+    span->next = nullptr;
+    span->prev = nullptr;
+    span->free_list = nullptr;
+    span->bump = memory + SPAN_HEADER_SIZE;
+    span->used = 0;
+    span->capacity = static_cast<u16>((span_size - SPAN_HEADER_SIZE) / class_size(size_class));
+    span->size_class = static_cast<u8>(size_class);
+    span->pages = static_cast<u8>(pages);
+    return span;
+}
+
+void SlabAllocator::unlink(SizeClass& sc, SlabSpan* span) {
+    if (span->prev)
+        span->prev->next = span->next;
+    else
+        sc.partial = span->next;
+    if (span->next)
+        span->next->prev = span->prev;
+    span->next = nullptr;
+    span->prev = nullptr;
+}
+
+void SlabAllocator::push_front(SizeClass& sc, SlabSpan* span) {
+    span->prev = nullptr;
+    span->next = sc.partial;
+    if (sc.partial)
+        sc.partial->prev = span;
+    sc.partial = span;
+}
+
+}
@@ -0,0 +1,134 @@
+#include <kernel/interrupts/idt.h>
+#include <kernel/util/kassert.h>
+#include <kernel/util/kprintf.h>
+
+namespace Kernel {
+
+// Present, ring 0, 32-bit interrupt gate.
+static constexpr u8 GATE_INTERRUPT = 0x8e;
+
+constinit IDT IDT::s_instance;
+
+static constexpr const char* EXCEPTION_NAMES[IDT::EXCEPTION_COUNT] = {
+    "Division error",
+    "Debug",
+    "Non-maskable interrupt",
+    "Breakpoint",
+    "Overflow",
+    "Bound range exceeded",
+    "Invalid opcode",
+    "Device not available",
+    "Double fault",
+    "Coprocessor segment overrun",
+    "Invalid TSS",
+    "Segment not present",
+    "Stack-segment fault",
+    "General protection fault",
+    "Page fault",
+    "Reserved",
+    "x87 floating-point exception",
+    "Alignment check",
+    "Machine check",
+    "SIMD floating-point exception",
+    "Virtualization exception",
+    "Control protection exception",
+    "Reserved",
+    "Reserved",
+    "Reserved",
+    "Reserved",
+    "Reserved",
+    "Reserved",
+    "Hypervisor injection exception",
+    "VMM communication exception",
+    "Security exception",
+    "Reserved",
+};
+
+[[noreturn]] static void exception(u8 vector, const InterruptFrame* frame, usize error_code) {
+    kprintf("%s (vector %d) at %p, ", EXCEPTION_NAMES[vector], vector, frame->eip);
+    kprintln("error code %x", error_code);
+    panic("Unhandled CPU exception");
+}
+
+template <u8 Vector>
+INTERRUPT_HANDLER static void exception_handler(InterruptFrame* frame) {
+    exception(Vector, frame, 0);
+}
+
+template <u8 Vector>
+INTERRUPT_HANDLER static void exception_handler_with_code(InterruptFrame* frame, usize error_code) {
+    exception(Vector, frame, error_code);
+}
+
+INTERRUPT_HANDLER static void ignore_interrupt(InterruptFrame*) {
+}
+
+void IDT::initialize() {
+    // The bootloader's flat code segment, whichever selector it happens to use.
+    asm volatile("mov %%cs, %0"
+                 : "=r"(m_code_selector));
+
+    // Some exceptions push an error code, which their handler has to take off the stack.
+#define EXCEPTION(vector) set_gate(vector, reinterpret_cast<usize>(&exception_handler<vector>));
+#define EXCEPTION_WITH_CODE(vector) set_gate(vector, reinterpret_cast<usize>(&exception_handler_with_code<vector>));
+    EXCEPTION(0)
+    EXCEPTION(1)
+    EXCEPTION(2)
+    EXCEPTION(3)
+    EXCEPTION(4)
+    EXCEPTION(5)
+    EXCEPTION(6)
+    EXCEPTION(7)
+    EXCEPTION_WITH_CODE(8)
+    EXCEPTION(9)
+    EXCEPTION_WITH_CODE(10)
+    EXCEPTION_WITH_CODE(11)
+    EXCEPTION_WITH_CODE(12)
+    EXCEPTION_WITH_CODE(13)
+    EXCEPTION_WITH_CODE(14)
+    EXCEPTION(15)
+    EXCEPTION(16)
+    EXCEPTION_WITH_CODE(17)
+    EXCEPTION(18)
+    EXCEPTION(19)
+    EXCEPTION(20)
+    EXCEPTION_WITH_CODE(21)
+    EXCEPTION(22)
+    EXCEPTION(23)
+    EXCEPTION(24)
+    EXCEPTION(25)
+    EXCEPTION(26)
+    EXCEPTION(27)
+    EXCEPTION(28)
+    EXCEPTION_WITH_CODE(29)
+    EXCEPTION_WITH_CODE(30)
+    EXCEPTION(31)
+#undef EXCEPTION
+#undef EXCEPTION_WITH_CODE
+
+    for (usize vector = EXCEPTION_COUNT; vector < ENTRIES; vector++)
+        set_gate(static_cast<u8>(vector), reinterpret_cast<usize>(&ignore_interrupt));
+
+    struct [[gnu::packed]] {
+        u16 limit;
+        usize base;
+    } pointer { sizeof(m_gates) - 1, reinterpret_cast<usize>(m_gates) };
+    asm volatile("lidt %0"
+                 :
+                 : "m"(pointer));
+}
+
+void IDT::set_handler(u8 vector, InterruptHandler handler) {
+    set_gate(vector, reinterpret_cast<usize>(handler));
+}
+
+void IDT::set_gate(u8 vector, usize address) {
+    auto& gate = m_gates[vector];
+    gate.offset_low = static_cast<u16>(address);
+    gate.selector = m_code_selector;
+    gate.zero = 0;
+    gate.type_attributes = GATE_INTERRUPT;
+    gate.offset_high = static_cast<u16>(address >> 16);
+}
+
+}
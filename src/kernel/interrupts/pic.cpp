@@ -0,0 +1,57 @@
+#include <kernel/interrupts/pic.h>
+#include <kernel/io/io.h>
+
+namespace Kernel::PIC {
+
+static constexpr u16 MASTER_COMMAND = 0x20;
+static constexpr u16 MASTER_DATA = 0x21;
+static constexpr u16 SLAVE_COMMAND = 0xa0;
+static constexpr u16 SLAVE_DATA = 0xa1;
+
+static constexpr u8 ICW1_INIT = 0x10;
+static constexpr u8 ICW1_ICW4 = 0x01;
+static constexpr u8 ICW4_8086 = 0x01;
+static constexpr u8 COMMAND_EOI = 0x20;
+// The slave is wired to IRQ 2 of the master.
+static constexpr u8 CASCADE_IRQ = 2;
+
+void remap() {
+    IO::outb(MASTER_COMMAND, ICW1_INIT | ICW1_ICW4);
+    IO::wait();
+    IO::outb(SLAVE_COMMAND, ICW1_INIT | ICW1_ICW4);
+    IO::wait();
+    IO::outb(MASTER_DATA, IRQ_BASE);
+    IO::wait();
+    IO::outb(SLAVE_DATA, IRQ_BASE + 8);
+    IO::wait();
+    IO::outb(MASTER_DATA, 1 << CASCADE_IRQ);
+    IO::wait();
+    IO::outb(SLAVE_DATA, CASCADE_IRQ);
+    IO::wait();
+    IO::outb(MASTER_DATA, ICW4_8086);
+    IO::wait();
+    IO::outb(SLAVE_DATA, ICW4_8086);
+    IO::wait();
+
+    // Everything masked but the cascade, which slave IRQs need once they are unmasked.
+    IO::outb(MASTER_DATA, static_cast<u8>(~(1 << CASCADE_IRQ)));
+    IO::outb(SLAVE_DATA, 0xff);
+}
+
+void mask(u8 irq) {
+    const auto port = irq < 8 ? MASTER_DATA : SLAVE_DATA;
+    IO::outb(port, static_cast<u8>(IO::inb(port) | (1 << (irq % 8))));
+}
+
+void unmask(u8 irq) {
+    const auto port = irq < 8 ? MASTER_DATA : SLAVE_DATA;
+    IO::outb(port, static_cast<u8>(IO::inb(port) & ~(1 << (irq % 8))));
+}
+
+void end_of_interrupt(u8 irq) {
+    if (irq >= 8)
+        IO::outb(SLAVE_COMMAND, COMMAND_EOI);
+    IO::outb(MASTER_COMMAND, COMMAND_EOI);
+}
+
+}
@@ -4,7 +4,6 @@
 #include <kernel/util/kassert.h>
 #include <kernel/util/kprintf.h>
 
-static constexpr u32 PIT_OSCILLATOR_FREQ = 1193182;
 static constexpr u16 PIT_CHANNEL_0 = 0x40;
 static constexpr u16 PIT_CHANNEL_2 = 0x42;
 static constexpr u16 PIT_CMD_REGISTER = 0x43;
@@ -37,11 +36,11 @@ void PIT::set_count(Channel c, u32 count) {
 }
 
 u32 PIT::count_for_frequency(u32 f) {
-    if (f < 20 || f > PIT_OSCILLATOR_FREQ) {
+    if (f < 20 || f > OSCILLATOR_FREQUENCY) {
         panic("PIT cannot produce requested frequency (20..=1193182)");
     }
 
-    return PIT_OSCILLATOR_FREQ / f;
+    return OSCILLATOR_FREQUENCY / f;
 }
 
 u32 PIT::read_count(Channel c) {
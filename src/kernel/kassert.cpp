@@ -10,6 +10,7 @@ void __assert_failure(const char* file, int line, const char* func, const char*
     if (TTY::is_initialized()) {
         TTY::set_color(VGA::Color::LIGHT_RED, VGA::Color::BLACK);
         kprintln("ASSERTION FAILED: %s\n         in file: %s:%d\n        function: %s", expr, file, line, func);
+        TTY::flush();
     }
 
     hang();
@@ -19,6 +20,7 @@ void __assert_failure_msg(const char* file, int line, const char* func, const ch
     if (TTY::is_initialized()) {
         TTY::set_color(VGA::Color::LIGHT_RED, VGA::Color::BLACK);
         kprintln("ASSERTION FAILED: %s\n      expression: %s\n         in file: %s:%d\n        function: %s", format, expr, file, line, func);
+        TTY::flush();
     }
     hang();
 }
@@ -29,6 +31,7 @@ void panic(const char* msg) {
         for (usize x = 0; x < VGA::width; x++)
             kputchar('#');
         kprintln("kernel panic: %s", msg);
+        TTY::flush();
     }
     hang();
 }
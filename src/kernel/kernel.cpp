@@ -3,17 +3,27 @@
 #include <kernel/fs/vfs.h>
 #include <kernel/heap/kmalloc.h>
 #include <kernel/interrupts/gdt.h>
+#include <kernel/interrupts/idt.h>
+#include <kernel/interrupts/pic.h>
 #include <kernel/interrupts/pit.h>
 #include <kernel/io/serial.h>
+#include <kernel/paging/page_directory.h>
 #include <kernel/processor/cpuid.h>
+#include <kernel/processor/mtrr.h>
+#include <kernel/processor/processor.h>
+#include <kernel/time/frame_pacer.h>
 #include <kernel/time/rtc.h>
+#include <kernel/time/timer.h>
 #include <kernel/util/asm.h>
 #include <kernel/util/kassert.h>
 #include <kernel/util/kprintf.h>
+#include <kernel/video/dispi.h>
 #include <kernel/video/fb.h>
+#include <kernel/video/fb_console.h>
 #include <kernel/video/tty.h>
 #include <kernel/video/vbe.h>
 #include <kernel/video/vga.h>
+#include <kernel/video/video_decoder.h>
 
 #include <libc/string.h>
 
@@ -39,20 +49,23 @@ extern const u8 _binary_bad_apple_bin_size;
 namespace Kernel {
 
 u64 total_system_memory = 0;
+// End of the highest usable memory range, everything below it gets identity mapped.
+u64 physical_memory_end = 0;
 
 Framebuffer* framebuffer;
 
-struct MemoryMapEntry {
-    u64 address;
-    u64 length;
-};
+// The kernel is loaded 1 MiB in at 0x100000 (see linker.ld)
+static constexpr usize KERNEL_START = 0x100000;
+// Free heap memory zeroed per idle step, small enough that a wait never overshoots its deadline by much.
+static constexpr usize IDLE_SCRUB_STEP = 16 * KiB;
 
-MemoryMapEntry find_best_memory(const multiboot_info_t* mbd) {
-    u64 address = 0;
-    u64 length = 0;
+MemoryMap build_memory_map(const Multiboot& multiboot, const multiboot_info_t* mbd) {
+    MemoryMap map;
 
-    for (usize i = 0; i < mbd->mmap_length; i += sizeof(multiboot_memory_map_t)) {
-        auto* mmap = reinterpret_cast<multiboot_memory_map_t*>(mbd->mmap_addr + i);
+    // Entries are variable-sized, each one starts with its own size (which does not count the size field itself).
+    for (usize offset = 0; offset < mbd->mmap_length;) {
+        const auto* mmap = reinterpret_cast<const multiboot_memory_map_t*>(mbd->mmap_addr + offset);
+        offset += mmap->size + sizeof(mmap->size);
 
         if (mmap->type != MULTIBOOT_MEMORY_AVAILABLE)
             continue;
@@ -61,30 +74,45 @@ MemoryMapEntry find_best_memory(const multiboot_info_t* mbd) {
         TTY::set_color(VGA::Color::LIGHT_GREY, VGA::Color::BLACK);
         // For some stupid reason these two have to be separated, or else
         // just one printf will always display 0x0 as the address.
-        kprintf("%dK ", mmap->len / KiB);
-        kprintln("at %p", mmap->addr);
+        kprintf("%dK ", static_cast<usize>(mmap->len / KiB));
+        kprintln("at %p", static_cast<usize>(mmap->addr));
         TTY::reset_color();
 
-        total_system_memory += static_cast<usize>(mmap->len);
-
-        // Use whatever is the biggest memory region as the extended memory.
-        // Normally we have two usable regions: 640K at 0x0, and everything beyond at 0x100000.
-        if (mmap->len > length) {
-            address = mmap->addr;
-            length = mmap->len;
-        }
+        total_system_memory += mmap->len;
+        if (mmap->addr + mmap->len > physical_memory_end)
+            physical_memory_end = mmap->addr + mmap->len;
+        map.add(mmap->addr, mmap->len);
     }
 
-    return { address, length };
-}
+    // Keep null pointers from ever being handed out.
+    map.reserve(0, MemoryManager::PAGE_SIZE);
+    // The kernel image, plus a guard area behind it.
+    map.reserve(KERNEL_START, reinterpret_cast<usize>(end_of_kernel_image) + 0x4000 - KERNEL_START);
+
+    // Everything the boot loader handed us still has to be readable after the heap is up.
+    map.reserve(reinterpret_cast<usize>(mbd), sizeof(multiboot_info_t));
+    map.reserve(mbd->mmap_addr, mbd->mmap_length);
+    if (const auto cmdline = multiboot.cmdline())
+        map.reserve(mbd->cmdline, strlen(cmdline.value()) + 1);
+    if (const auto name = multiboot.boot_loader_name())
+        map.reserve(mbd->boot_loader_name, strlen(name.value()) + 1);
+    if (multiboot.has_flag(MultibootFlag::VBE)) {
+        map.reserve(mbd->vbe_control_info, 512);
+        map.reserve(mbd->vbe_mode_info, 256);
+    }
+    if (multiboot.has_flag(MultibootFlag::MODULES)) {
+        const auto* modules = reinterpret_cast<const multiboot_module_t*>(mbd->mods_addr);
+        map.reserve(mbd->mods_addr, mbd->mods_count * sizeof(multiboot_module_t));
+        for (usize i = 0; i < mbd->mods_count; i++)
+            map.reserve(modules[i].mod_start, modules[i].mod_end - modules[i].mod_start);
+    }
+    // Some firmware reports the framebuffer as usable memory.
+    if (const auto fb = multiboot.framebuffer())
+        map.reserve(fb.value().address, static_cast<u64>(fb.value().pitch) * fb.value().height);
 
-void initialize_memory_manager(u64 extended_memory_start, u64 extended_memory_size) {
-    // The kernel is loaded 1 MiB in at 0x100000 (see linker.ld)
-    // To avoid writing over it, we'll start allocating memory at the end of the kernel image.
-    const auto offset = 0x4000;
-    const auto kernel_size = reinterpret_cast<usize>(end_of_kernel_image) - extended_memory_start;
-    const auto adjusted_memory_size = extended_memory_size - kernel_size - offset;
-    MemoryManager::get().initialize(reinterpret_cast<usize>(end_of_kernel_image) + kernel_size + offset, adjusted_memory_size);
+    // Without PAE, nothing above 4 GiB is addressable.
+    map.trim(static_cast<u64>(1) << 32, MemoryManager::PAGE_SIZE);
+    return map;
 }
 
 void print_rtc() {
@@ -129,6 +157,25 @@ bool test_vbe(const Multiboot& multiboot) {
     return true;
 }
 
+// Write-combining lets the CPU merge the back buffer copy into full bus bursts instead of single uncached stores.
+void map_framebuffer(usize address, u64 size) {
+    auto& directory = PageDirectory::kernel();
+    auto flags = PageFlags::Writable | PageFlags::Global;
+
+    kprintf("Framebuffer memory type: ");
+    if (directory.supports_write_combining()) {
+        flags = flags | PageFlags::WriteCombining;
+        kprintln("write-combining (PAT)");
+    } else if (MTRR::set_write_combining(address, size)) {
+        kprintln("write-combining (MTRR)");
+    } else {
+        kprintln("left to the firmware, write-combining not available");
+    }
+
+    // The framebuffer usually sits far above RAM, outside of what paging mapped so far.
+    directory.identity_map(address, size, flags);
+}
+
 Framebuffer* setup_framebuffer(const Multiboot& multiboot) {
     auto maybe_fb = multiboot.framebuffer();
     if (!maybe_fb)
@@ -150,13 +197,20 @@ Framebuffer* setup_framebuffer(const Multiboot& multiboot) {
     if (type != MultibootFramebufferType::RGB)
         panic("Unsupported multiboot framebuffer type");
 
-    return new Framebuffer(address, width, height, pitch, depth);
+    // With the Bochs display interface, both buffers can live in video memory and presenting just flips between them.
+    const auto page_flipping = DISPI::is_active(width, height, depth, pitch) && DISPI::page_count(height) >= 2;
+    kprintln("Bochs DISPI page flipping %s", page_flipping ? "available" : "not available, copying frames");
+
+    map_framebuffer(reinterpret_cast<usize>(address), static_cast<u64>(pitch) * height * (page_flipping ? 2 : 1));
+
+    return new Framebuffer(address, width, height, pitch, depth, page_flipping);
 }
 
 void play_the_funny() {
     static constexpr u32 width = 64;
     static constexpr u32 height = 48;
     static constexpr u32 n_frames = 6570;
+    static constexpr u32 fps = 30;
 
     kassert(width < framebuffer->width());
     kassert(height < framebuffer->height());
@@ -165,54 +219,70 @@ void play_the_funny() {
     usize data_size = _binary_bad_apple_bin_end - _binary_bad_apple_bin_start;
     usize size_per_frame = width * height;
 
-    const auto put_pixel = [](u8* buffer, u32 x, u32 y, u8 color, u32 pitch) {
-        u32 location = x * 3 + y * pitch;
-        buffer[location] = color;
-        buffer[location + 1] = color;
-        buffer[location + 2] = color;
-
-        buffer[location + 3] = color;
-        buffer[location + 4] = color;
-        buffer[location + 5] = color;
+    // tools/encode_video.py turns the raw frames into a delta-coded stream. Raw frames still play as before.
+    auto decoder = VideoDecoder::open(data_start, data_size);
+    if (decoder) {
+        kassert(decoder.value().width() * 2 <= framebuffer->width() && decoder.value().height() * 2 <= framebuffer->height());
+        kprintln("Bad Apple: %d encoded frames in %dK", decoder.value().frame_count(), data_size / KiB);
+    } else {
+        kprintln("Bad Apple: raw frames, %dK", data_size / KiB);
+    }
 
-        location += pitch;
-        buffer[location] = color;
-        buffer[location + 1] = color;
-        buffer[location + 2] = color;
+    // Encoded frames only draw what changed on top of the previous one, raw frames are redrawn in full.
+    const auto draw_frame = [&](usize frame) {
+        if (decoder)
+            return decoder.value().decode_frame(*framebuffer, 0, 0, 2);
 
-        buffer[location + 3] = color;
-        buffer[location + 4] = color;
-        buffer[location + 5] = color;
+        if ((frame + 1) * size_per_frame > data_size)
+            return false;
+        framebuffer->clear();
+        framebuffer->blit(Image { data_start + frame * size_per_frame, width, height, width, ImageFormat::Gray8 }, 0, 0, 2);
+        return true;
     };
 
-    const auto pitch = framebuffer->pitch();
+    u64 total_draw_cycles = 0;
+    u64 max_draw_cycles = 0;
+    usize frames_drawn = 0;
 
-    for (usize frame = 0; frame < n_frames; frame++) {
-        framebuffer->clear();
+    // Start from black instead of on top of the boot log.
+    framebuffer->clear();
 
-        auto* write_buffer = framebuffer->write_buffer();
+    auto pacer = Time::FramePacer(Time::Timer::get(), fps);
+    pacer.start();
 
-        if (frame * size_per_frame >= data_size)
+    usize next_frame = 0;
+    while (true) {
+        const auto frame = static_cast<usize>(pacer.wait_for_frame());
+        if (frame >= n_frames)
             break;
 
-        for (usize x = 0; x < width; x++) {
-            for (usize y = 0; y < height; y++) {
-                usize scaled_x = x * 2;
-                usize scaled_y = y * 2;
-
-                u8 pixel = data_start[frame * size_per_frame + (y * width + x)];
+        const auto start = rdtsc();
 
-                put_pixel(write_buffer, scaled_x, scaled_y, pixel, pitch);
-                put_pixel(write_buffer, scaled_x + 1, scaled_y, pixel, pitch);
-                put_pixel(write_buffer, scaled_x, scaled_y + 1, pixel, pitch);
-                put_pixel(write_buffer, scaled_x + 1, scaled_y + 1, pixel, pitch);
-            }
+        // Encoded frames build on each other, so the ones being dropped still have to be decoded, just not presented.
+        if (!decoder)
+            next_frame = frame;
+        auto drawn = true;
+        while (drawn && next_frame <= frame) {
+            drawn = draw_frame(next_frame);
+            next_frame++;
         }
+        if (!drawn)
+            break;
 
-        framebuffer->swap_buffers();
+        const auto cycles = rdtsc() - start;
+        total_draw_cycles += cycles;
+        if (cycles > max_draw_cycles)
+            max_draw_cycles = cycles;
+        frames_drawn++;
 
-        IO::wait_for(10000);
+        framebuffer->swap_buffers();
+        pacer.presented();
     }
+
+    kprintf("Bad Apple: %d frames, drawing took ", frames_drawn);
+    kprintf("%d cycles per frame on average, ", frames_drawn ? static_cast<usize>(total_draw_cycles / frames_drawn) : 0);
+    kprintln("%d at most", static_cast<usize>(max_draw_cycles));
+    pacer.stats().print();
 }
 
 }
@@ -234,10 +304,10 @@ extern "C" [[gnu::used]] void kernel_main(multiboot_info_t* mbd, u32 magic) {
 
     print_rtc();
 
-    const auto memory_map_entry = find_best_memory(mbd);
+    const auto memory_map = build_memory_map(multiboot, mbd);
     kprintf("End of kernel: ");
     TTY::set_color(VGA::Color::LIGHT_GREY, VGA::Color::BLACK);
-    kprintln("%p (size: %dK)", end_of_kernel_image, ((usize)end_of_kernel_image - memory_map_entry.address) / KiB);
+    kprintln("%p (size: %dK)", end_of_kernel_image, (reinterpret_cast<usize>(end_of_kernel_image) - KERNEL_START) / KiB);
     TTY::reset_color();
     kprintf("Command line: ");
     TTY::set_color(VGA::Color::LIGHT_GREY, VGA::Color::BLACK);
@@ -251,13 +321,52 @@ extern "C" [[gnu::used]] void kernel_main(multiboot_info_t* mbd, u32 magic) {
     if (!test_vbe(multiboot))
         panic("VESA BIOS Extensions (VBE) not present");
 
-    initialize_memory_manager(memory_map_entry.address, memory_map_entry.length);
-    framebuffer = setup_framebuffer(multiboot);
+    MemoryManager::get().initialize(memory_map);
 
     auto cpuid = CPUID();
     print_cpu_info(cpuid);
+    // Boot with `nosse` to compare against the scalar paths.
+    Processor::initialize(cpuid, !strstr(multiboot.cmdline().value_or(""), "nosse"));
+
+    // Round up to whole 4 MiB pages, but stay within the 32-bit address space.
+    static constexpr u64 LARGE_PAGE_MASK = PageDirectory::LARGE_PAGE_SIZE - 1;
+    const auto identity_limit = (physical_memory_end + LARGE_PAGE_MASK) & ~LARGE_PAGE_MASK;
+    PageDirectory::kernel().initialize(cpuid, identity_limit < (static_cast<u64>(1) << 32) ? identity_limit : static_cast<u64>(1) << 32);
 
-    play_the_funny();
+    IDT::get().initialize();
+    PIC::remap();
+    Time::Timer::get().initialize(1000);
+    // Time spent waiting on the timer goes to zeroing free heap memory, so later zeroed allocations find it clean.
+    Time::Timer::get().set_idle_hook([] { return MemoryManager::get().scrub(IDLE_SCRUB_STEP) != 0; });
+    sti();
+
+    framebuffer = setup_framebuffer(multiboot);
 
-    delete framebuffer;
+    // The VGA text buffer isn't on screen in graphics mode, so the boot log continues in the framebuffer.
+    FramebufferConsole* console = nullptr;
+    if (framebuffer) {
+        console = new FramebufferConsole(*framebuffer);
+        TTY::attach_console(console);
+        kprintln("Framebuffer console: %dx%d characters", console->columns(), console->rows());
+
+        play_the_funny();
+
+        // Playback drew over the console.
+        console->invalidate();
+        framebuffer->present_stats().print();
+    }
+
+    MemoryManager::get().stats().print();
+    MemoryManager::get().pages().stats().print();
+
+    // Boot with `alloc_trace` on the command line to get the recent heap events over serial.
+    if (strstr(multiboot.cmdline().value_or(""), "alloc_trace"))
+        MemoryManager::get().trace().dump();
+
+    // Only tear the console down once everything has been printed, so the stats stay on screen.
+    if (console) {
+        TTY::attach_console(nullptr);
+        delete console;
+        delete framebuffer;
+    }
 }
@@ -0,0 +1,228 @@
+#include <kernel/heap/kmalloc.h>
+#include <kernel/paging/page_directory.h>
+#include <kernel/processor/cpuid.h>
+#include <kernel/util/asm.h>
+#include <kernel/util/kassert.h>
+#include <kernel/util/kprintf.h>
+
+#include <libc/string.h>
+
+namespace Kernel {
+
+static constexpr u32 ENTRY_PRESENT = (1 << 0);
+static constexpr u32 ENTRY_WRITABLE = (1 << 1);
+// Directory entries only: the entry maps a 4 MiB page instead of pointing to a page table.
+static constexpr u32 ENTRY_LARGE = (1 << 7);
+// The PAT bit sits at bit 7 in page table entries, and moves to bit 12 in 4 MiB directory entries.
+static constexpr u32 PTE_PAT = (1 << 7);
+static constexpr u32 LARGE_PAT = (1 << 12);
+static constexpr u32 FLAGS_MASK = 0x1ff;
+static constexpr u32 TABLE_ADDRESS_MASK = 0xfffff000;
+static constexpr u32 LARGE_ADDRESS_MASK = 0xffc00000;
+
+// PAT entry 4 (PAT bit set, PCD and PWT clear) is write-back by default, the same as entry 0, so it is free to be
+// repurposed without changing what the WriteThrough and CacheDisable flags mean.
+static constexpr u32 MSR_PAT = 0x277;
+static constexpr u64 PAT_WRITE_COMBINING_ENTRY = 4;
+static constexpr u64 PAT_TYPE_WRITE_COMBINING = 0x01;
+
+static constexpr usize CR0_WRITE_PROTECT = (1 << 16);
+static constexpr usize CR0_PAGING = (1u << 31);
+static constexpr usize CR4_PSE = (1 << 4);
+static constexpr usize CR4_PGE = (1 << 7);
+
+constinit PageDirectory PageDirectory::s_kernel;
+
+static usize directory_index(usize virtual_address) {
+    return virtual_address / PageDirectory::LARGE_PAGE_SIZE;
+}
+
+static usize table_index(usize virtual_address) {
+    return (virtual_address / PageDirectory::PAGE_SIZE) % PageDirectory::ENTRIES;
+}
+
+static u32* allocate_table() {
+    const auto address = MemoryManager::get().pages().allocate(0);
+    kassert_msg(address, "PageDirectory: Out of memory for page tables");
+
+    auto* table = reinterpret_cast<u32*>(address.value());
+    memset(table, 0, PageDirectory::PAGE_SIZE);
+    return table;
+}
+
+void PageDirectory::initialize(CPUID& cpuid, u64 identity_limit) {
+    m_large_pages = cpuid.has_feature(CPUFeature::PSE);
+    m_global_pages = cpuid.has_feature(CPUFeature::PGE);
+    m_write_combining = cpuid.has_feature(CPUFeature::PAT);
+    m_entries = allocate_table();
+
+    // Nothing is mapped through the entry yet, so there are no cached lines or TLB entries of the old type to flush.
+    if (m_write_combining) {
+        const auto shift = PAT_WRITE_COMBINING_ENTRY * 8;
+        const auto pat = rdmsr(MSR_PAT) & ~(static_cast<u64>(0xff) << shift);
+        wrmsr(MSR_PAT, pat | PAT_TYPE_WRITE_COMBINING << shift);
+    }
+
+    // Both have to be enabled before the first entries using them are loaded.
+    auto cr4 = read_cr4();
+    if (m_large_pages)
+        cr4 |= CR4_PSE;
+    if (m_global_pages)
+        cr4 |= CR4_PGE;
+    write_cr4(cr4);
+
+    identity_map(0, identity_limit, PageFlags::Writable | PageFlags::Global);
+    // Leave page 0 unmapped, so null pointer accesses fault instead of going through. This splits the first
+    // 4 MiB page into a page table, the rest of low memory stays identity mapped.
+    unmap_page(0);
+
+    write_cr3(reinterpret_cast<usize>(m_entries));
+    // With write protection on, the kernel can't write through read-only mappings either.
+    write_cr0(read_cr0() | CR0_PAGING | CR0_WRITE_PROTECT);
+
+    kprintf("Paging enabled, %dK identity mapped with ", static_cast<usize>(identity_limit / KiB));
+    kprintf("%s pages%s%s", m_large_pages ? "4M" : "4K", m_global_pages ? ", global" : "", m_write_combining ? ", PAT" : "");
+    kprintln(", page 0 unmapped");
+}
+
+u32 PageDirectory::entry_flags(PageFlags flags, bool large) const {
+    auto bits = static_cast<u32>(flags);
+    if (!m_global_pages)
+        bits &= ~static_cast<u32>(PageFlags::Global);
+    if (bits & static_cast<u32>(PageFlags::WriteCombining)) {
+        bits &= ~static_cast<u32>(PageFlags::WriteCombining);
+        if (m_write_combining)
+            bits |= large ? LARGE_PAT : PTE_PAT;
+    }
+    return bits | ENTRY_PRESENT;
+}
+
+u32* PageDirectory::table_for(usize virtual_address) {
+    auto& entry = m_entries[directory_index(virtual_address)];
+
+    if (!(entry & ENTRY_PRESENT)) {
+        entry = reinterpret_cast<usize>(allocate_table()) | ENTRY_PRESENT | ENTRY_WRITABLE;
+        return reinterpret_cast<u32*>(entry & TABLE_ADDRESS_MASK);
+    }
+
+    if (entry & ENTRY_LARGE) {
+        // Split the 4 MiB page into 1024 small ones with the same attributes. The translations don't change,
+        // so the stale TLB entry for the large page can stay until the caller flushes the page it remaps.
+        auto* table = allocate_table();
+        auto flags = entry & FLAGS_MASK & ~ENTRY_LARGE;
+        if (entry & LARGE_PAT)
+            flags |= PTE_PAT;
+
+        const auto base = entry & LARGE_ADDRESS_MASK;
+        for (usize i = 0; i < ENTRIES; i++)
+            table[i] = static_cast<u32>(base + i * PAGE_SIZE) | flags;
+
+        entry = reinterpret_cast<usize>(table) | ENTRY_PRESENT | ENTRY_WRITABLE;
+        return table;
+    }
+
+    return reinterpret_cast<u32*>(entry & TABLE_ADDRESS_MASK);
+}
+
+void PageDirectory::free_table(u32 directory_entry) {
+    if ((directory_entry & ENTRY_PRESENT) && !(directory_entry & ENTRY_LARGE))
+        MemoryManager::get().pages().free(directory_entry & TABLE_ADDRESS_MASK, 0);
+}
+
+void PageDirectory::map_page(usize virtual_address, usize physical_address, PageFlags flags) {
+    kassert((virtual_address % PAGE_SIZE) == 0 && (physical_address % PAGE_SIZE) == 0);
+
+    ScopedSpinlock lock(m_lock);
+    auto* table = table_for(virtual_address);
+    table[table_index(virtual_address)] = static_cast<u32>(physical_address) | entry_flags(flags, false);
+    flush(virtual_address);
+}
+
+void PageDirectory::map_large_page(usize virtual_address, usize physical_address, PageFlags flags) {
+    kassert_msg(m_large_pages, "PageDirectory: 4 MiB pages need PSE");
+    kassert((virtual_address % LARGE_PAGE_SIZE) == 0 && (physical_address % LARGE_PAGE_SIZE) == 0);
+
+    ScopedSpinlock lock(m_lock);
+    auto& entry = m_entries[directory_index(virtual_address)];
+    const auto previous = entry;
+    entry = static_cast<u32>(physical_address) | entry_flags(flags, true) | ENTRY_LARGE;
+
+    // Any of the 1024 small pages of a replaced table might still be cached.
+    free_table(previous);
+    if ((previous & ENTRY_PRESENT) && !(previous & ENTRY_LARGE))
+        flush_all();
+    else
+        flush(virtual_address);
+}
+
+void PageDirectory::unmap_page(usize virtual_address) {
+    ScopedSpinlock lock(m_lock);
+    if (!(m_entries[directory_index(virtual_address)] & ENTRY_PRESENT))
+        return;
+
+    auto* table = table_for(virtual_address);
+    table[table_index(virtual_address)] = 0;
+    flush(virtual_address);
+}
+
+void PageDirectory::unmap_large_page(usize virtual_address) {
+    kassert((virtual_address % LARGE_PAGE_SIZE) == 0);
+
+    ScopedSpinlock lock(m_lock);
+    auto& entry = m_entries[directory_index(virtual_address)];
+    const auto previous = entry;
+    entry = 0;
+
+    free_table(previous);
+    if ((previous & ENTRY_PRESENT) && !(previous & ENTRY_LARGE))
+        flush_all();
+    else
+        flush(virtual_address);
+}
+
+void PageDirectory::identity_map(usize address, u64 size, PageFlags flags) {
+    auto current = static_cast<u64>(address & ~(PAGE_SIZE - 1));
+    const auto end = (static_cast<u64>(address) + size + PAGE_SIZE - 1) & ~static_cast<u64>(PAGE_SIZE - 1);
+
+    while (current < end) {
+        const auto page = static_cast<usize>(current);
+        if (m_large_pages && (page % LARGE_PAGE_SIZE) == 0 && end - current >= LARGE_PAGE_SIZE) {
+            map_large_page(page, page, flags);
+            current += LARGE_PAGE_SIZE;
+        } else {
+            map_page(page, page, flags);
+            current += PAGE_SIZE;
+        }
+    }
+}
+
+Optional<usize> PageDirectory::physical_address(usize virtual_address) const {
+    const auto entry = m_entries[directory_index(virtual_address)];
+    if (!(entry & ENTRY_PRESENT))
+        return Optional<usize>::empty();
+    if (entry & ENTRY_LARGE)
+        return (entry & LARGE_ADDRESS_MASK) | (virtual_address & (LARGE_PAGE_SIZE - 1));
+
+    const auto* table = reinterpret_cast<const u32*>(entry & TABLE_ADDRESS_MASK);
+    const auto page = table[table_index(virtual_address)];
+    if (!(page & ENTRY_PRESENT))
+        return Optional<usize>::empty();
+    return (page & TABLE_ADDRESS_MASK) | (virtual_address & (PAGE_SIZE - 1));
+}
+
+void PageDirectory::flush(usize virtual_address) {
+    invlpg(virtual_address);
+}
+
+void PageDirectory::flush_all() {
+    // Reloading CR3 keeps global entries, toggling PGE drops everything.
+    if (m_global_pages) {
+        const auto cr4 = read_cr4();
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    } else {
+        write_cr3(read_cr3());
+    }
+}
+
+}
@@ -196,4 +196,14 @@ ProcessorInfo CPUID::info() {
     return info;
 }
 
+u32 CPUID::physical_address_bits() {
+    get(CPUIDRequest::GET_HIGHEST_EXTENDED_FUNCTION);
+    if (m_eax >= static_cast<u32>(CPUIDRequest::GET_ADDRESS_SIZES)) {
+        get(CPUIDRequest::GET_ADDRESS_SIZES);
+        return m_eax & 0xff;
+    }
+
+    return has_feature(CPUFeature::PAE) || has_feature(CPUFeature::PSE36) ? 36 : 32;
+}
+
 }
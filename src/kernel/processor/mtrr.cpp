@@ -0,0 +1,100 @@
+#include <kernel/processor/cpuid.h>
+#include <kernel/processor/mtrr.h>
+#include <kernel/util/asm.h>
+
+namespace Kernel::MTRR {
+
+static constexpr u32 MSR_MTRR_CAPABILITIES = 0xfe;
+static constexpr u32 MSR_MTRR_DEFAULT_TYPE = 0x2ff;
+// Variable range n is described by the base/mask MSR pair at 0x200 + 2n.
+static constexpr u32 MSR_MTRR_PHYSICAL_BASE = 0x200;
+static constexpr u32 MSR_MTRR_PHYSICAL_MASK = 0x201;
+
+static constexpr u64 CAPABILITIES_COUNT_MASK = 0xff;
+static constexpr u64 CAPABILITIES_WRITE_COMBINING = (1 << 10);
+static constexpr u64 DEFAULT_TYPE_ENABLE = (1 << 11);
+static constexpr u64 MASK_VALID = (1 << 11);
+static constexpr u64 TYPE_MASK = 0xff;
+static constexpr u64 PAGE_MASK = 0xfff;
+
+static constexpr u64 TYPE_WRITE_COMBINING = 0x01;
+
+static constexpr usize CR0_NOT_WRITE_THROUGH = (1 << 29);
+static constexpr usize CR0_CACHE_DISABLE = (1 << 30);
+static constexpr usize CR4_PGE = (1 << 7);
+
+static u32 base_msr(u32 index) { return MSR_MTRR_PHYSICAL_BASE + index * 2; }
+static u32 mask_msr(u32 index) { return MSR_MTRR_PHYSICAL_MASK + index * 2; }
+
+bool set_write_combining(u64 base, u64 size) {
+    CPUID cpuid;
+    if (!cpuid.has_feature(CPUFeature::MSR) || !cpuid.has_feature(CPUFeature::MTRR))
+        return false;
+
+    const auto capabilities = rdmsr(MSR_MTRR_CAPABILITIES);
+    if (!(capabilities & CAPABILITIES_WRITE_COMBINING))
+        return false;
+
+    auto range = PAGE_MASK + 1;
+    while (range < size)
+        range <<= 1;
+    if (base & (range - 1))
+        return false;
+
+    const auto address_mask = (static_cast<u64>(1) << cpuid.physical_address_bits()) - 1;
+    const auto mask = ~(range - 1) & address_mask & ~PAGE_MASK;
+
+    const auto count = static_cast<u32>(capabilities & CAPABILITIES_COUNT_MASK);
+    auto free_index = count;
+    for (u32 i = 0; i < count; i++) {
+        const auto other_mask = rdmsr(mask_msr(i));
+        if (!(other_mask & MASK_VALID)) {
+            if (free_index == count)
+                free_index = i;
+            continue;
+        }
+
+        // Two ranges overlap if they agree on every address bit both of them compare. Between variable ranges, only
+        // uncacheable over anything and write-through over write-back are defined, so write-combining can only go
+        // on top of a range that is write-combining already.
+        const auto other_base = rdmsr(base_msr(i));
+        const auto common = mask & other_mask & ~PAGE_MASK;
+        if ((other_base & TYPE_MASK) != TYPE_WRITE_COMBINING && (other_base & common) == (base & common))
+            return false;
+    }
+    if (free_index == count)
+        return false;
+
+    // The update sequence from the Intel SDM (11.11.7.2): no other accesses may be cached with the old types
+    // while the ranges change, so caching is turned off and the caches and TLBs are flushed around it.
+    const auto interrupts_enabled = has_flag(CPUFlag::InterruptEnable);
+    cli();
+
+    const auto cr0 = read_cr0();
+    write_cr0((cr0 | CR0_CACHE_DISABLE) & ~CR0_NOT_WRITE_THROUGH);
+    wbinvd();
+    const auto cr4 = read_cr4();
+    if (cr4 & CR4_PGE)
+        write_cr4(cr4 & ~CR4_PGE);
+    else
+        write_cr3(read_cr3());
+
+    const auto default_type = rdmsr(MSR_MTRR_DEFAULT_TYPE);
+    wrmsr(MSR_MTRR_DEFAULT_TYPE, default_type & ~DEFAULT_TYPE_ENABLE);
+    wrmsr(base_msr(free_index), (base & address_mask & ~PAGE_MASK) | TYPE_WRITE_COMBINING);
+    wrmsr(mask_msr(free_index), mask | MASK_VALID);
+    wrmsr(MSR_MTRR_DEFAULT_TYPE, default_type);
+
+    wbinvd();
+    if (cr4 & CR4_PGE)
+        write_cr4(cr4);
+    else
+        write_cr3(read_cr3());
+    write_cr0(cr0);
+
+    if (interrupts_enabled)
+        sti();
+    return true;
+}
+
+}
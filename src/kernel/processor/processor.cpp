@@ -0,0 +1,34 @@
+#include <kernel/processor/cpuid.h>
+#include <kernel/processor/processor.h>
+#include <kernel/util/asm.h>
+#include <kernel/util/kprintf.h>
+
+namespace Kernel {
+
+static constexpr usize CR0_MONITOR_COPROCESSOR = (1 << 1);
+static constexpr usize CR0_EMULATION = (1 << 2);
+static constexpr usize CR0_NUMERIC_ERROR = (1 << 5);
+static constexpr usize CR4_OSFXSR = (1 << 9);
+static constexpr usize CR4_OSXMMEXCPT = (1 << 10);
+
+void Processor::initialize(CPUID& cpuid, bool use_sse) {
+    if (!cpuid.has_feature(CPUFeature::FPU)) {
+        kprintln("Processor: No FPU, floating point and SSE stay off");
+        return;
+    }
+
+    // Execute FPU instructions instead of trapping, and report FPU errors as exceptions rather than through the PIC.
+    write_cr0((read_cr0() | CR0_MONITOR_COPROCESSOR | CR0_NUMERIC_ERROR) & ~CR0_EMULATION);
+    asm volatile("fninit");
+
+    if (!use_sse || !cpuid.has_feature(CPUFeature::SSE) || !cpuid.has_feature(CPUFeature::FXSR)) {
+        kprintln("Processor: FPU enabled, SSE %s", use_sse ? "not supported" : "disabled");
+        return;
+    }
+
+    write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    s_sse2 = cpuid.has_feature(CPUFeature::SSE2);
+    kprintln("Processor: FPU and SSE%s enabled", s_sse2 ? "2" : "");
+}
+
+}
@@ -0,0 +1,90 @@
+#include <kernel/time/frame_pacer.h>
+#include <kernel/time/timer.h>
+#include <kernel/util/asm.h>
+#include <kernel/util/kprintf.h>
+
+namespace Kernel::Time {
+
+FramePacer::FramePacer(Timer& timer, u32 fps)
+    : m_timer(timer)
+    , m_fps(fps) {
+}
+
+void FramePacer::start() {
+    m_start_tick = m_timer.ticks();
+    m_start_cycles = rdtsc();
+    m_next_frame = 0;
+}
+
+u64 FramePacer::wait_for_frame() {
+    auto frame = m_next_frame;
+    const auto deadline = m_start_tick + m_timer.ticks_for(frame, m_fps);
+
+    m_timer.wait_until(deadline);
+
+    const auto due = m_timer.time_in(m_timer.ticks() - m_start_tick, m_fps);
+    if (due > frame) {
+        m_dropped += static_cast<usize>(due - frame);
+        frame = due;
+    }
+
+    m_next_frame = frame + 1;
+    return frame;
+}
+
+void FramePacer::presented() {
+    const auto now = rdtsc();
+    if (m_presented == 0) {
+        m_first_present_cycles = now;
+    } else {
+        const auto interval = now - m_last_present_cycles;
+        if (m_presented == 1 || interval < m_min_interval_cycles)
+            m_min_interval_cycles = interval;
+        if (interval > m_max_interval_cycles)
+            m_max_interval_cycles = interval;
+    }
+    m_last_present_cycles = now;
+    m_presented++;
+
+    // Presenting took so long that the next frame is already due.
+    if (m_timer.time_in(m_timer.ticks() - m_start_tick, m_fps) >= m_next_frame)
+        m_late++;
+}
+
+FramePacer::Stats FramePacer::stats() const {
+    Stats stats {};
+    stats.fps = m_fps;
+    stats.presented = m_presented;
+    stats.dropped = m_dropped;
+    stats.late = m_late;
+    stats.elapsed_cycles = m_last_present_cycles - m_first_present_cycles;
+    stats.min_interval_cycles = m_min_interval_cycles;
+    stats.max_interval_cycles = m_max_interval_cycles;
+
+    const auto microseconds = m_timer.time_in(m_timer.ticks() - m_start_tick, 1000000);
+    if (microseconds != 0)
+        stats.cycles_per_second = (rdtsc() - m_start_cycles) * 1000000 / microseconds;
+    return stats;
+}
+
+void FramePacer::Stats::print() const {
+    if (presented < 2 || elapsed_cycles == 0 || cycles_per_second == 0) {
+        kprintln("Frame pacing: %d frames presented, too few to measure", presented);
+        return;
+    }
+
+    // kprintf has no floating point, so FPS are printed with two decimals from fixed point.
+    const auto centi_fps = static_cast<usize>((presented - 1) * cycles_per_second * 100 / elapsed_cycles);
+    const auto target_interval = cycles_per_second / fps;
+    const auto early = target_interval > min_interval_cycles ? target_interval - min_interval_cycles : 0;
+    const auto late_by = max_interval_cycles > target_interval ? max_interval_cycles - target_interval : 0;
+    const auto jitter = static_cast<usize>((early > late_by ? early : late_by) * 1000000 / cycles_per_second);
+
+    kprintf("Frame pacing: %d.%d", centi_fps / 100, centi_fps / 10 % 10);
+    kprintf("%d FPS (target %d), ", centi_fps % 10, fps);
+    kprintf("jitter %dus, ", jitter);
+    kprintf("%d presented, %d dropped, ", presented, dropped);
+    kprintln("%d late", late);
+}
+
+}
@@ -0,0 +1,70 @@
+#include <kernel/interrupts/idt.h>
+#include <kernel/interrupts/pic.h>
+#include <kernel/interrupts/pit.h>
+#include <kernel/time/timer.h>
+#include <kernel/util/asm.h>
+#include <kernel/util/interrupt_scope.h>
+#include <kernel/util/kassert.h>
+
+namespace Kernel::Time {
+
+static constexpr u8 TIMER_IRQ = 0;
+
+constinit Timer Timer::s_instance;
+
+INTERRUPT_HANDLER static void timer_interrupt(InterruptFrame*) {
+    Timer::get().tick();
+    PIC::end_of_interrupt(TIMER_IRQ);
+}
+
+void Timer::initialize(u32 frequency) {
+    PIT pit;
+    m_count = pit.count_for_frequency(frequency);
+    m_frequency = PIT::OSCILLATOR_FREQUENCY / m_count;
+    m_ticks = 0;
+
+    IDT::get().set_handler(PIC::IRQ_BASE + TIMER_IRQ, timer_interrupt);
+    pit.enable(PIT::Channel::IRQ, PIT::AccessMode::LoHiByte, PIT::OperatingMode::RateGenerator, PIT::BCDBinaryMode::Binary, static_cast<i32>(frequency));
+    PIC::unmask(TIMER_IRQ);
+}
+
+u64 Timer::ticks() const {
+    // Two 32-bit loads, which the interrupt must not land between.
+    InterruptScope _;
+    return m_ticks;
+}
+
+u64 Timer::ticks_for(u64 amount, u32 per_second) const {
+    const auto divisor = static_cast<u64>(per_second) * m_count;
+    return (amount * PIT::OSCILLATOR_FREQUENCY + divisor - 1) / divisor;
+}
+
+u64 Timer::time_in(u64 ticks, u32 per_second) const {
+    return ticks * m_count * per_second / PIT::OSCILLATOR_FREQUENCY;
+}
+
+void Timer::wait_until(u64 tick) const {
+    kassert_msg(has_flag(CPUFlag::InterruptEnable), "Timer: Waiting with interrupts disabled would never end");
+
+    // Leave a tick of slack for the idle work that is running when time runs out.
+    if (m_idle_hook) {
+        while (ticks() + 1 < tick) {
+            if (!m_idle_hook())
+                break;
+        }
+    }
+
+    while (true) {
+        cli();
+        if (m_ticks >= tick)
+            break;
+        // sti only takes effect after the next instruction, so a tick can't slip in between and leave hlt waiting.
+        asm volatile("sti; hlt"
+                     :
+                     :
+                     : "memory");
+    }
+    sti();
+}
+
+}
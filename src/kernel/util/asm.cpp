@@ -34,4 +34,76 @@ u64 rdtsc() {
     return static_cast<u64>(msw) << 32 | lsw;
 }
 
+usize read_cr0() {
+    usize value;
+    asm volatile("mov %%cr0, %0"
+                 : "=r"(value));
+    return value;
+}
+
+void write_cr0(usize value) {
+    asm volatile("mov %0, %%cr0"
+                 :
+                 : "r"(value)
+                 : "memory");
+}
+
+usize read_cr3() {
+    usize value;
+    asm volatile("mov %%cr3, %0"
+                 : "=r"(value));
+    return value;
+}
+
+void write_cr3(usize value) {
+    asm volatile("mov %0, %%cr3"
+                 :
+                 : "r"(value)
+                 : "memory");
+}
+
+usize read_cr4() {
+    usize value;
+    asm volatile("mov %%cr4, %0"
+                 : "=r"(value));
+    return value;
+}
+
+void write_cr4(usize value) {
+    asm volatile("mov %0, %%cr4"
+                 :
+                 : "r"(value)
+                 : "memory");
+}
+
+void invlpg(usize address) {
+    asm volatile("invlpg (%0)"
+                 :
+                 : "r"(address)
+                 : "memory");
+}
+
+void wbinvd() {
+    asm volatile("wbinvd"
+                 :
+                 :
+                 : "memory");
+}
+
+u64 rdmsr(u32 msr) {
+    u32 lsw;
+    u32 msw;
+    asm volatile("rdmsr"
+                 : "=d"(msw), "=a"(lsw)
+                 : "c"(msr));
+    return static_cast<u64>(msw) << 32 | lsw;
+}
+
+void wrmsr(u32 msr, u64 value) {
+    asm volatile("wrmsr"
+                 :
+                 : "c"(msr), "a"(static_cast<u32>(value)), "d"(static_cast<u32>(value >> 32))
+                 : "memory");
+}
+
 }
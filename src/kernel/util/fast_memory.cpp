@@ -0,0 +1,107 @@
+#include <kernel/processor/processor.h>
+#include <kernel/util/fast_memory.h>
+
+#include <libc/string.h>
+
+namespace Kernel {
+
+typedef char Vector16 __attribute__((vector_size(16)));
+typedef long long Vector2x64 __attribute__((vector_size(16)));
+
+static constexpr usize VECTOR_SIZE = 16;
+// Four vectors per iteration, a full cache line.
+static constexpr usize BLOCK_SIZE = 4 * VECTOR_SIZE;
+
+// Bytes until the next 16 byte boundary, limited to size.
+static usize unaligned_head(const u8* destination, usize size) {
+    const auto head = (VECTOR_SIZE - (reinterpret_cast<usize>(destination) & (VECTOR_SIZE - 1))) & (VECTOR_SIZE - 1);
+    return head < size ? head : size;
+}
+
+[[gnu::target("sse2")]] static void stream_copy_sse2(u8* destination, const u8* source, usize size) {
+    // Only the destination has to be aligned, the source is read with unaligned loads.
+    const auto head = unaligned_head(destination, size);
+    memcpy(destination, source, head);
+    destination += head;
+    source += head;
+    size -= head;
+
+    for (; size >= BLOCK_SIZE; size -= BLOCK_SIZE, destination += BLOCK_SIZE, source += BLOCK_SIZE) {
+        for (usize i = 0; i < BLOCK_SIZE; i += VECTOR_SIZE) {
+            const auto vector = __builtin_ia32_loaddqu(reinterpret_cast<const char*>(source + i));
+            __builtin_ia32_movntdq(reinterpret_cast<Vector2x64*>(destination + i), reinterpret_cast<Vector2x64>(vector));
+        }
+    }
+    for (; size >= VECTOR_SIZE; size -= VECTOR_SIZE, destination += VECTOR_SIZE, source += VECTOR_SIZE) {
+        const auto vector = __builtin_ia32_loaddqu(reinterpret_cast<const char*>(source));
+        __builtin_ia32_movntdq(reinterpret_cast<Vector2x64*>(destination), reinterpret_cast<Vector2x64>(vector));
+    }
+    memcpy(destination, source, size);
+
+    // Non-temporal stores are weakly ordered, make them visible before anything written afterwards.
+    __builtin_ia32_sfence();
+}
+
+[[gnu::target("sse2")]] static void fast_copy_sse2(u8* destination, const u8* source, usize size) {
+    for (; size >= BLOCK_SIZE; size -= BLOCK_SIZE, destination += BLOCK_SIZE, source += BLOCK_SIZE) {
+        for (usize i = 0; i < BLOCK_SIZE; i += VECTOR_SIZE) {
+            const auto vector = __builtin_ia32_loaddqu(reinterpret_cast<const char*>(source + i));
+            __builtin_ia32_storedqu(reinterpret_cast<char*>(destination + i), vector);
+        }
+    }
+    for (; size >= VECTOR_SIZE; size -= VECTOR_SIZE, destination += VECTOR_SIZE, source += VECTOR_SIZE)
+        __builtin_ia32_storedqu(reinterpret_cast<char*>(destination), __builtin_ia32_loaddqu(reinterpret_cast<const char*>(source)));
+    memcpy(destination, source, size);
+}
+
+static void fast_copy_scalar(u8* destination, const u8* source, usize size) {
+    auto dwords = size / 4;
+    auto bytes = size % 4;
+    asm volatile("rep movsl"
+                 : "+D"(destination), "+S"(source), "+c"(dwords)
+                 :
+                 : "memory");
+    asm volatile("rep movsb"
+                 : "+D"(destination), "+S"(source), "+c"(bytes)
+                 :
+                 : "memory");
+}
+
+[[gnu::target("sse2")]] static void fast_fill_sse2(u8* destination, u8 value, usize size) {
+    const auto head = unaligned_head(destination, size);
+    memset(destination, value, head);
+    destination += head;
+    size -= head;
+
+    const auto pattern = Vector16 {} + static_cast<char>(value);
+    for (; size >= BLOCK_SIZE; size -= BLOCK_SIZE, destination += BLOCK_SIZE) {
+        for (usize i = 0; i < BLOCK_SIZE; i += VECTOR_SIZE)
+            *reinterpret_cast<Vector16*>(destination + i) = pattern;
+    }
+    for (; size >= VECTOR_SIZE; size -= VECTOR_SIZE, destination += VECTOR_SIZE)
+        *reinterpret_cast<Vector16*>(destination) = pattern;
+    memset(destination, value, size);
+}
+
+void stream_copy(void* destination, const void* source, usize size) {
+    if (Processor::has_sse2())
+        stream_copy_sse2(static_cast<u8*>(destination), static_cast<const u8*>(source), size);
+    else
+        memcpy(destination, source, size);
+}
+
+void fast_copy(void* destination, const void* source, usize size) {
+    if (Processor::has_sse2())
+        fast_copy_sse2(static_cast<u8*>(destination), static_cast<const u8*>(source), size);
+    else
+        fast_copy_scalar(static_cast<u8*>(destination), static_cast<const u8*>(source), size);
+}
+
+void fast_fill(void* destination, u8 value, usize size) {
+    if (Processor::has_sse2())
+        fast_fill_sse2(static_cast<u8*>(destination), value, size);
+    else
+        memset(destination, value, size);
+}
+
+}
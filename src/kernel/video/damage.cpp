@@ -0,0 +1,81 @@
+#include <kernel/video/damage.h>
+
+namespace Kernel {
+
+static u32 min(u32 a, u32 b) { return a < b ? a : b; }
+static u32 max(u32 a, u32 b) { return a > b ? a : b; }
+
+Rect Rect::united(const Rect& other) const {
+    if (is_empty())
+        return other;
+    if (other.is_empty())
+        return *this;
+
+    const auto left = min(x, other.x);
+    const auto top = min(y, other.y);
+    return { left, top, max(right(), other.right()) - left, max(bottom(), other.bottom()) - top };
+}
+
+Rect Rect::clipped(u32 max_width, u32 max_height) const {
+    if (x >= max_width || y >= max_height)
+        return { 0, 0, 0, 0 };
+    return { x, y, min(width, max_width - x), min(height, max_height - y) };
+}
+
+void DamageTracker::add(const Rect& rect) {
+    if (m_full_frame)
+        return;
+
+    auto merged = rect.clipped(m_width, m_height);
+    if (merged.is_empty())
+        return;
+
+    while (true) {
+        // The union can grow into rectangles that were checked before it, so start over after every merge.
+        for (usize i = 0; i < m_count;) {
+            if (m_rects[i].touches(merged)) {
+                merged = merged.united(m_rects[i]);
+                remove_at(i);
+                i = 0;
+            } else {
+                i++;
+            }
+        }
+        if (m_count < MAX_RECTS)
+            break;
+
+        usize best = 0;
+        auto best_growth = static_cast<usize>(-1);
+        for (usize i = 0; i < m_count; i++) {
+            const auto growth = m_rects[i].united(merged).area() - m_rects[i].area();
+            if (growth < best_growth) {
+                best = i;
+                best_growth = growth;
+            }
+        }
+        merged = merged.united(m_rects[best]);
+        remove_at(best);
+    }
+
+    m_rects[m_count++] = merged;
+
+    m_area = 0;
+    for (usize i = 0; i < m_count; i++)
+        m_area += m_rects[i].area();
+    if (m_area * 100 > static_cast<usize>(m_width) * m_height * FULL_FRAME_PERCENT)
+        m_full_frame = true;
+}
+
+void DamageTracker::reset() {
+    m_count = 0;
+    m_area = 0;
+    m_full_frame = false;
+}
+
+void DamageTracker::remove_at(usize index) {
+    for (auto i = index; i + 1 < m_count; i++)
+        m_rects[i] = m_rects[i + 1];
+    m_count--;
+}
+
+}
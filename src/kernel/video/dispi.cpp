@@ -0,0 +1,51 @@
+#include <kernel/io/io.h>
+#include <kernel/video/dispi.h>
+
+namespace Kernel::DISPI {
+
+static constexpr u16 INDEX_PORT = 0x1ce;
+static constexpr u16 DATA_PORT = 0x1cf;
+
+// Every interface revision reports its own ID, from the first one to the one with VideoMemory64K.
+static constexpr u16 ID_FIRST = 0xb0c0;
+static constexpr u16 ID_LAST = 0xb0c5;
+
+static constexpr u16 ENABLED = (1 << 0);
+static constexpr u16 LINEAR_FRAMEBUFFER = (1 << 6);
+
+u16 read(Register reg) {
+    IO::outw(INDEX_PORT, static_cast<u16>(reg));
+    return IO::inw(DATA_PORT);
+}
+
+void write(Register reg, u16 value) {
+    IO::outw(INDEX_PORT, static_cast<u16>(reg));
+    IO::outw(DATA_PORT, value);
+}
+
+bool is_active(u32 width, u32 height, u32 depth, u32 pitch) {
+    const auto id = read(Register::ID);
+    if (id < ID_FIRST || id > ID_LAST)
+        return false;
+
+    const auto enable = read(Register::Enable);
+    if ((enable & (ENABLED | LINEAR_FRAMEBUFFER)) != (ENABLED | LINEAR_FRAMEBUFFER))
+        return false;
+
+    if (read(Register::XResolution) != width || read(Register::YResolution) != height || read(Register::BitsPerPixel) != depth)
+        return false;
+
+    // Y offsets count lines of the virtual screen, which have to match the pitch used to draw.
+    return static_cast<u32>(read(Register::VirtualWidth)) * (depth / 8) == pitch;
+}
+
+u32 page_count(u32 height) {
+    // The virtual height follows from the virtual width and video memory size, writes to it are ignored.
+    return height ? read(Register::VirtualHeight) / height : 0;
+}
+
+void set_y_offset(u32 line) {
+    write(Register::YOffset, static_cast<u16>(line));
+}
+
+}
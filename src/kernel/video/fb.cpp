@@ -1,44 +1,191 @@
 #include <kernel/heap/kmalloc.h>
+#include <kernel/processor/processor.h>
+#include <kernel/util/asm.h>
+#include <kernel/util/fast_memory.h>
 #include <kernel/util/kassert.h>
 #include <kernel/util/kprintf.h>
+#include <kernel/video/dispi.h>
 #include <kernel/video/fb.h>
-#include <libc/string.h>
 
 namespace Kernel {
 
-Framebuffer::Framebuffer(u8* hw_buffer, u32 width, u32 height, u32 pitch, u32 depth)
+Framebuffer::Framebuffer(u8* hw_buffer, u32 width, u32 height, u32 pitch, u32 depth, bool page_flipping)
     : m_front_buffer(hw_buffer)
     , m_width(width)
     , m_height(height)
     , m_pitch(pitch)
-    , m_depth(depth) {
+    , m_depth(depth)
+    , m_bytes_per_pixel(depth / 8)
+    , m_pixels(PixelOperations::for_depth(depth))
+    , m_damage(width, height)
+    , m_drawn { { 0, 0, width, height }, { 0, 0, width, height } }
+    , m_page_flipping(page_flipping)
+    , m_back_page(page_flipping ? 1 : 0)
+    , m_stale(width, height) {
+    m_present_stats.page_flipping = page_flipping;
     m_buffer_size = pitch * height;
+    if (!m_pixels)
+        panic("Unsupported framebuffer depth, only 16 (5:6:5), 24 and 32 bits per pixel can be drawn");
 
     kprintln("Creating framebuffer %dx%d %dbpp size %d", width, height, depth, m_buffer_size);
-    m_back_buffer = static_cast<u8*>(kmalloc(m_buffer_size));
+    if (m_page_flipping) {
+        m_back_buffer = m_front_buffer + m_buffer_size;
+        DISPI::set_y_offset(0);
+    } else {
+        m_back_buffer = static_cast<u8*>(kmalloc(m_buffer_size));
+    }
 
     if (!m_back_buffer)
         panic("Framebuffer allocation failed. Ensure the memory manager has enough resources available to handle the requested resolution.");
 
     clear();
 
-    kprintln("Created framebuffer. front=%p back=%p", m_front_buffer, m_back_buffer);
+    kprintln("Created framebuffer. front=%p back=%p%s", m_front_buffer, m_back_buffer, m_page_flipping ? " (page flipping)" : "");
 }
 
 Framebuffer::~Framebuffer() {
-    kfree(m_back_buffer);
+    if (!m_page_flipping)
+        kfree(m_back_buffer);
 }
 
-u8* Framebuffer::write_buffer() const {
+u8* Framebuffer::write_buffer() {
+    catch_up_back_buffer();
     return m_back_buffer;
 }
 
 void Framebuffer::swap_buffers() {
-    memcpy(m_front_buffer, m_back_buffer, m_buffer_size);
+    const auto start = rdtsc();
+
+    if (m_page_flipping) {
+        // Flipping to an unchanged page would show the frame before the current one.
+        if (!m_damage.is_empty()) {
+            DISPI::set_y_offset(m_back_page * m_height);
+            auto* presented = m_back_buffer;
+            m_back_buffer = m_front_buffer;
+            m_front_buffer = presented;
+            m_back_page ^= 1;
+
+            m_stale = m_damage;
+            m_back_buffer_stale = true;
+        }
+    } else {
+        copy_damage(m_front_buffer, m_back_buffer, m_damage);
+    }
+
+    m_damage.reset();
+
+    const auto cycles = rdtsc() - start;
+    m_present_stats.presents++;
+    m_present_stats.total_cycles += cycles;
+    if (cycles > m_present_stats.max_cycles)
+        m_present_stats.max_cycles = cycles;
 }
 
 void Framebuffer::clear() {
-    memset(m_back_buffer, 0, m_buffer_size);
+    // Erasing everything this page has drawn leaves it black, whatever it missed from the page on screen.
+    m_back_buffer_stale = false;
+
+    auto& drawn = m_drawn[m_back_page];
+    if (!drawn.is_empty()) {
+        if (drawn.width == m_width) {
+            fast_fill(m_back_buffer + drawn.y * m_pitch, 0, drawn.height * m_pitch);
+        } else {
+            const auto row_size = drawn.width * m_bytes_per_pixel;
+            for (auto y = drawn.y; y < drawn.bottom(); y++)
+                fast_fill(m_back_buffer + y * m_pitch + drawn.x * m_bytes_per_pixel, 0, row_size);
+        }
+
+        m_damage.add(drawn);
+        drawn = { 0, 0, 0, 0 };
+    }
+
+    // Whatever the page on screen shows disappears with the next flip.
+    if (m_page_flipping)
+        m_damage.add(m_drawn[m_back_page ^ 1]);
+}
+
+void Framebuffer::fill_rect(const Rect& rect, u32 color) {
+    const auto clipped = rect.clipped(m_width, m_height);
+    if (clipped.is_empty())
+        return;
+
+    catch_up_back_buffer();
+
+    const auto pixel = m_pixels->from_rgb(color);
+    auto* row = m_back_buffer + clipped.y * m_pitch + clipped.x * m_bytes_per_pixel;
+    for (u32 i = 0; i < clipped.height; i++, row += m_pitch)
+        m_pixels->fill_span(row, pixel, clipped.width);
+
+    mark_dirty(clipped);
+}
+
+void Framebuffer::hline(u32 x, u32 y, u32 width, u32 color) {
+    fill_rect({ x, y, width, 1 }, color);
+}
+
+void Framebuffer::blit(const Image& image, u32 x, u32 y, u32 scale) {
+    kassert(scale != 0);
+
+    const auto visible = Rect { x, y, image.width * scale, image.height * scale }.clipped(m_width, m_height);
+    if (visible.is_empty())
+        return;
+
+    catch_up_back_buffer();
+
+    const auto row_size = visible.width * m_bytes_per_pixel;
+    auto* destination = m_back_buffer + y * m_pitch + x * m_bytes_per_pixel;
+    auto line = y;
+    for (u32 source_y = 0; source_y < image.height && line < visible.bottom(); source_y++) {
+        auto* expanded = destination;
+        m_pixels->convert_row(expanded, image, image.row(source_y), scale, visible.width);
+        destination += m_pitch;
+        line++;
+
+        for (u32 i = 1; i < scale && line < visible.bottom(); i++, line++) {
+            fast_copy(destination, expanded, row_size);
+            destination += m_pitch;
+        }
+    }
+
+    mark_dirty(visible);
+}
+
+void Framebuffer::mark_dirty(const Rect& rect) {
+    const auto clipped = rect.clipped(m_width, m_height);
+    m_damage.add(clipped);
+    m_drawn[m_back_page] = m_drawn[m_back_page].united(clipped);
+}
+
+void Framebuffer::catch_up_back_buffer() {
+    if (!m_back_buffer_stale)
+        return;
+
+    m_back_buffer_stale = false;
+    copy_damage(m_back_buffer, m_front_buffer, m_stale);
+    m_drawn[m_back_page] = m_drawn[m_back_page].united(m_drawn[m_back_page ^ 1]);
+}
+
+void Framebuffer::copy_damage(u8* destination, const u8* source, const DamageTracker& damage) const {
+    if (damage.is_full_frame()) {
+        stream_copy(destination, source, m_buffer_size);
+        return;
+    }
+
+    for (usize i = 0; i < damage.count(); i++) {
+        const auto& rect = damage.rect(i);
+        const auto row_size = rect.width * m_bytes_per_pixel;
+        for (auto y = rect.y; y < rect.bottom(); y++) {
+            const auto offset = y * m_pitch + rect.x * m_bytes_per_pixel;
+            stream_copy(destination + offset, source + offset, row_size);
+        }
+    }
+}
+
+void Framebuffer::PresentStats::print() const {
+    const auto* mode = page_flipping ? "page flip" : Processor::has_sse2() ? "SSE2 non-temporal" : "scalar";
+    kprintf("Present (%s): %d frames, ", mode, presents);
+    kprintf("%d cycles average, ", presents ? static_cast<usize>(total_cycles / presents) : 0);
+    kprintln("%d max", static_cast<usize>(max_cycles));
 }
 
 u32 Framebuffer::width() const { return m_width; }
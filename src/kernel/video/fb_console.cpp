@@ -0,0 +1,190 @@
+#include <kernel/heap/kmalloc.h>
+#include <kernel/util/fast_memory.h>
+#include <kernel/util/kassert.h>
+#include <kernel/video/fb_console.h>
+#include <kernel/video/font.h>
+#include <kernel/video/vga.h>
+
+#include <libc/string.h>
+
+namespace Kernel {
+
+// The 16 text mode colors, as the VGA DAC has them by default.
+static constexpr u32 VGA_PALETTE[16] = {
+    0x000000, 0x0000aa, 0x00aa00, 0x00aaaa, 0xaa0000, 0xaa00aa, 0xaa5500, 0xaaaaaa,
+    0x555555, 0x5555ff, 0x55ff55, 0x55ffff, 0xff5555, 0xff55ff, 0xffff55, 0xffffff
+};
+
+static constexpr u32 NO_GLYPH = 0xffffffff;
+static constexpr u32 TAB_WIDTH = 4;
+
+static char entry_char(u16 entry) { return static_cast<char>(entry & 0xff); }
+static u8 entry_color(u16 entry) { return static_cast<u8>(entry >> 8); }
+
+// The low 7 bits of the character pick one of 128 slots, and two bits folded out of the color one of four banks,
+// so the handful of color pairs a boot log uses rarely evict each other.
+static usize glyph_cache_slot(u16 entry) {
+    const auto color = entry_color(entry);
+    return (static_cast<usize>(entry & 0x7f) | static_cast<usize>((color ^ (color >> 4)) & 3) << 7) % FramebufferConsole::GLYPH_CACHE_SIZE;
+}
+
+FramebufferConsole::FramebufferConsole(Framebuffer& framebuffer)
+    : m_framebuffer(framebuffer)
+    , m_pixels(PixelOperations::for_depth(framebuffer.depth()))
+    , m_columns(framebuffer.width() / Font::GLYPH_WIDTH)
+    , m_rows(framebuffer.height() / Font::GLYPH_HEIGHT) {
+    kassert(m_pixels && m_columns && m_rows);
+
+    for (usize i = 0; i < 16; i++)
+        m_palette[i] = m_pixels->from_rgb(VGA_PALETTE[i]);
+
+    m_glyph_pitch = Font::GLYPH_WIDTH * m_pixels->bytes_per_pixel;
+    m_glyph_size = m_glyph_pitch * Font::GLYPH_HEIGHT;
+
+    m_cells = static_cast<u16*>(kmalloc(m_columns * m_rows * sizeof(u16)));
+    m_dirty_lines = static_cast<bool*>(kmalloc(m_rows * sizeof(bool)));
+    m_glyph_cache = static_cast<u8*>(kmalloc(GLYPH_CACHE_SIZE * m_glyph_size));
+    m_glyph_cache_keys = static_cast<u32*>(kmalloc(GLYPH_CACHE_SIZE * sizeof(u32)));
+
+    const auto blank = VGA::entry(' ', VGA::entry_color(VGA::Color::LIGHT_GREY, VGA::Color::BLACK));
+    for (usize i = 0; i < m_columns * m_rows; i++)
+        m_cells[i] = blank;
+    for (usize i = 0; i < GLYPH_CACHE_SIZE; i++)
+        m_glyph_cache_keys[i] = NO_GLYPH;
+    invalidate();
+}
+
+FramebufferConsole::~FramebufferConsole() {
+    kfree(m_cells);
+    kfree(m_dirty_lines);
+    kfree(m_glyph_cache);
+    kfree(m_glyph_cache_keys);
+}
+
+void FramebufferConsole::put_char(char c, u8 color) {
+    switch (c) {
+    case '\n': {
+        new_line(color);
+    } break;
+    case '\t': {
+        m_column += TAB_WIDTH;
+        if (m_column >= m_columns)
+            new_line(color);
+    } break;
+    case '\b': {
+        if (m_column > 0)
+            m_column--;
+    } break;
+    default: {
+        m_cells[m_row * m_columns + m_column] = VGA::entry(c, color);
+        m_dirty_lines[m_row] = true;
+        m_dirty = true;
+        if (++m_column == m_columns)
+            new_line(color);
+    }
+    }
+}
+
+void FramebufferConsole::new_line(u8 color) {
+    m_column = 0;
+    if (++m_row == m_rows) {
+        m_row--;
+
+        // Only the grid moves now, the pixels follow in one go on the next flush.
+        memmove(m_cells, m_cells + m_columns, (m_rows - 1) * m_columns * sizeof(u16));
+        memmove(m_dirty_lines, m_dirty_lines + 1, (m_rows - 1) * sizeof(bool));
+
+        // The new line takes the background of the text that pushed it in.
+        const auto blank = VGA::entry(' ', color & 0xf0);
+        for (usize x = 0; x < m_columns; x++)
+            m_cells[m_row * m_columns + x] = blank;
+        m_dirty_lines[m_row] = true;
+        m_dirty = true;
+
+        if (m_pending_scroll < m_rows)
+            m_pending_scroll++;
+    }
+
+    if (++m_lines_since_flush >= FLUSH_INTERVAL)
+        flush();
+}
+
+void FramebufferConsole::flush() {
+    m_lines_since_flush = 0;
+    if (!m_dirty)
+        return;
+
+    auto* buffer = m_framebuffer.write_buffer();
+    const auto text_area = Rect { 0, 0, m_columns * Font::GLYPH_WIDTH, m_rows * Font::GLYPH_HEIGHT };
+
+    // Once every line scrolled out, all of them are dirty anyway and there is nothing left worth moving.
+    if (m_pending_scroll > 0 && m_pending_scroll < m_rows) {
+        scroll_pixels(buffer, m_pending_scroll);
+        m_framebuffer.mark_dirty(text_area);
+    }
+    m_pending_scroll = 0;
+
+    for (u32 row = 0; row < m_rows; row++) {
+        if (!m_dirty_lines[row])
+            continue;
+        draw_line(buffer, row);
+        m_dirty_lines[row] = false;
+        m_framebuffer.mark_dirty({ 0, row * Font::GLYPH_HEIGHT, text_area.width, Font::GLYPH_HEIGHT });
+    }
+    m_dirty = false;
+
+    m_framebuffer.swap_buffers();
+}
+
+void FramebufferConsole::invalidate() {
+    for (usize row = 0; row < m_rows; row++)
+        m_dirty_lines[row] = true;
+    m_dirty = true;
+    m_pending_scroll = 0;
+}
+
+void FramebufferConsole::scroll_pixels(u8* buffer, u32 lines) const {
+    const auto pitch = m_framebuffer.pitch();
+    const auto row_size = m_columns * m_glyph_pitch;
+    const auto distance = lines * Font::GLYPH_HEIGHT;
+    const auto kept = (m_rows - lines) * Font::GLYPH_HEIGHT;
+
+    // A source row is always at least a whole glyph height below its destination, so the rows never overlap.
+    for (u32 y = 0; y < kept; y++)
+        fast_copy(buffer + y * pitch, buffer + (y + distance) * pitch, row_size);
+}
+
+void FramebufferConsole::draw_line(u8* buffer, u32 row) {
+    const auto pitch = m_framebuffer.pitch();
+    auto* line = buffer + row * Font::GLYPH_HEIGHT * pitch;
+
+    for (u32 column = 0; column < m_columns; column++) {
+        const auto* glyph = expanded_glyph(m_cells[row * m_columns + column]);
+        auto* destination = line + column * m_glyph_pitch;
+        for (u32 y = 0; y < Font::GLYPH_HEIGHT; y++, destination += pitch, glyph += m_glyph_pitch)
+            fast_copy(destination, glyph, m_glyph_pitch);
+    }
+}
+
+const u8* FramebufferConsole::expanded_glyph(u16 entry) {
+    const auto slot = glyph_cache_slot(entry);
+    auto* pixels = m_glyph_cache + slot * m_glyph_size;
+    if (m_glyph_cache_keys[slot] == entry)
+        return pixels;
+
+    const auto color = entry_color(entry);
+    const auto foreground = m_palette[color & 0xf];
+    const auto background = m_palette[color >> 4];
+    const auto* bitmap = Font::glyph(entry_char(entry));
+
+    auto* destination = pixels;
+    for (u32 y = 0; y < Font::GLYPH_HEIGHT; y++) {
+        for (u32 x = 0; x < Font::GLYPH_WIDTH; x++, destination += m_pixels->bytes_per_pixel)
+            m_pixels->fill_span(destination, (bitmap[y] & (0x80 >> x)) ? foreground : background, 1);
+    }
+
+    m_glyph_cache_keys[slot] = entry;
+    return pixels;
+}
+
+}
@@ -0,0 +1,109 @@
+#include <kernel/video/pixel_format.h>
+
+namespace Kernel {
+
+// Writes 32-bit words with a string store, for formats whose pixels pack evenly into them.
+static u8* store_words(u8* destination, u32 word, usize count) {
+    asm volatile("rep stosl"
+                 : "+D"(destination), "+c"(count)
+                 : "a"(word)
+                 : "memory");
+    return destination;
+}
+
+template <typename Format>
+static void fill_span(u8* destination, u32 pixel, u32 count);
+
+template <>
+void fill_span<XRGB32Format>(u8* destination, u32 pixel, u32 count) {
+    store_words(destination, pixel, count);
+}
+
+template <>
+void fill_span<RGB565Format>(u8* destination, u32 pixel, u32 count) {
+    // Align to a 32-bit boundary first, then store two pixels at a time.
+    if ((reinterpret_cast<usize>(destination) & 2) && count > 0) {
+        RGB565Format::store(destination, pixel);
+        destination += 2;
+        count--;
+    }
+    destination = store_words(destination, pixel | pixel << 16, count / 2);
+    if (count % 2)
+        RGB565Format::store(destination, pixel);
+}
+
+template <>
+void fill_span<RGB24Format>(u8* destination, u32 pixel, u32 count) {
+    // Four pixels make three 32-bit words, which saves splitting every pixel into single bytes.
+    const u32 words[3] = {
+        pixel | pixel << 24,
+        pixel >> 8 | pixel << 16,
+        pixel >> 16 | pixel << 8,
+    };
+    auto* word = reinterpret_cast<u32*>(destination);
+    for (; count >= 4; count -= 4) {
+        *word++ = words[0];
+        *word++ = words[1];
+        *word++ = words[2];
+    }
+
+    destination = reinterpret_cast<u8*>(word);
+    for (; count > 0; count--, destination += 3)
+        RGB24Format::store(destination, pixel);
+}
+
+template <typename Format, ImageFormat Source>
+static void convert_row(u8* destination, const u8* row, u32 scale, u32 width) {
+    for (u32 x = 0; width > 0; x++) {
+        u32 rgb;
+        if constexpr (Source == ImageFormat::Gray8) {
+            rgb = row[x] * 0x010101u;
+        } else {
+            const auto* source = row + x * 3;
+            rgb = static_cast<u32>(source[0]) << 16 | static_cast<u32>(source[1]) << 8 | source[2];
+        }
+
+        const auto pixel = Format::from_rgb(rgb);
+        const auto count = scale < width ? scale : width;
+        for (u32 i = 0; i < count; i++, destination += Format::BYTES_PER_PIXEL)
+            Format::store(destination, pixel);
+        width -= count;
+    }
+}
+
+template <typename Format>
+static void convert_row(u8* destination, const Image& image, const u8* row, u32 scale, u32 width) {
+    if (image.format == ImageFormat::Gray8)
+        convert_row<Format, ImageFormat::Gray8>(destination, row, scale, width);
+    else
+        convert_row<Format, ImageFormat::RGB24>(destination, row, scale, width);
+}
+
+template <typename Format>
+static u32 from_rgb(u32 rgb) {
+    return Format::from_rgb(rgb);
+}
+
+template <typename Format>
+static constexpr PixelOperations operations_for() {
+    return { Format::BYTES_PER_PIXEL, from_rgb<Format>, fill_span<Format>, convert_row<Format> };
+}
+
+static constexpr PixelOperations RGB24_OPERATIONS = operations_for<RGB24Format>();
+static constexpr PixelOperations XRGB32_OPERATIONS = operations_for<XRGB32Format>();
+static constexpr PixelOperations RGB565_OPERATIONS = operations_for<RGB565Format>();
+
+const PixelOperations* PixelOperations::for_depth(u32 depth) {
+    switch (depth) {
+    case 16:
+        return &RGB565_OPERATIONS;
+    case 24:
+        return &RGB24_OPERATIONS;
+    case 32:
+        return &XRGB32_OPERATIONS;
+    default:
+        return nullptr;
+    }
+}
+
+}
@@ -1,4 +1,5 @@
 #include <kernel/io/serial.h>
+#include <kernel/video/fb_console.h>
 #include <kernel/video/tty.h>
 #include <kernel/video/vga.h>
 
@@ -8,6 +9,12 @@ static constexpr auto video_memory_addr = 0xB8000;
 
 static bool initialized = false;
 
+// The last output without a console attached, replayed into the console once there is one.
+static constexpr usize history_size = 8192;
+static u16 history[history_size];
+static usize history_length = 0;
+static FramebufferConsole* console = nullptr;
+
 usize current_row;
 usize current_column;
 u8 current_color;
@@ -62,6 +69,12 @@ int put_char(char c) {
     if (IO::Serial::ready())
         IO::Serial::write(static_cast<u8>(c));
 
+    if (console) {
+        console->put_char(c, current_color);
+        return 1;
+    }
+    history[history_length++ % history_size] = VGA::entry(c, current_color);
+
     switch (c) {
     case '\n': {
         current_column = 0;
@@ -93,6 +106,35 @@ int put_char(char c) {
     return 1;
 }
 
+void attach_console(FramebufferConsole* new_console) {
+    if (console)
+        console->flush();
+    console = new_console;
+    if (!console)
+        return;
+
+    // Once the history wrapped around, its oldest line is cut off, so start with the first complete one.
+    auto start = history_length > history_size ? history_length - history_size : 0;
+    if (history_length > history_size) {
+        while (start < history_length && static_cast<char>(history[start % history_size]) != '\n')
+            start++;
+        start++;
+    }
+
+    for (auto i = start; i < history_length; i++) {
+        const auto entry = history[i % history_size];
+        console->put_char(static_cast<char>(entry & 0xff), static_cast<u8>(entry >> 8));
+    }
+    history_length = 0;
+
+    console->flush();
+}
+
+void flush() {
+    if (console)
+        console->flush();
+}
+
 namespace Cursor {
 
     void enable(u8 start, u8 end) {
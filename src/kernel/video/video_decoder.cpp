@@ -0,0 +1,105 @@
+#include <kernel/video/fb.h>
+#include <kernel/video/video_decoder.h>
+
+namespace Kernel {
+
+static constexpr usize HEADER_SIZE = 12;
+static constexpr u8 MAGIC[4] = { 'B', 'A', 'V', '1' };
+
+static constexpr u8 TOKEN_RUN = 0x80;
+static constexpr u32 SKIP_COUNT_MAX = 0x7f;
+static constexpr u32 RUN_COUNT_MAX = 0x07;
+
+static u32 read_le(const u8* data, usize bytes) {
+    u32 value = 0;
+    for (usize i = 0; i < bytes; i++)
+        value |= static_cast<u32>(data[i]) << (i * 8);
+    return value;
+}
+
+Optional<VideoDecoder> VideoDecoder::open(const u8* data, usize size) {
+    if (size < HEADER_SIZE)
+        return Optional<VideoDecoder>::empty();
+    for (usize i = 0; i < sizeof(MAGIC); i++) {
+        if (data[i] != MAGIC[i])
+            return Optional<VideoDecoder>::empty();
+    }
+
+    VideoDecoder decoder;
+    decoder.m_width = read_le(data + 4, 2);
+    decoder.m_height = read_le(data + 6, 2);
+    decoder.m_frame_count = read_le(data + 8, 4);
+    decoder.m_data = data + HEADER_SIZE;
+    decoder.m_end = data + size;
+    if (decoder.m_width == 0 || decoder.m_height == 0)
+        return Optional<VideoDecoder>::empty();
+    return decoder;
+}
+
+bool VideoDecoder::read_count(u32 field, u32 field_max, u32& count) {
+    count = field + 1;
+    if (field != field_max)
+        return true;
+
+    u32 extra = 0;
+    for (u32 shift = 0; shift < 32; shift += 7) {
+        if (m_data == m_end)
+            return false;
+        const auto byte = *m_data++;
+        // Only the low 4 bits of a fifth byte still fit into 32 bits.
+        if (shift == 28 && (byte & 0x70))
+            return false;
+        extra |= static_cast<u32>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            // A wrapped count could slip past the bounds checks of the caller.
+            if (extra > UINT32_MAX - count)
+                return false;
+            count += extra;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VideoDecoder::decode_frame(Framebuffer& framebuffer, u32 x, u32 y, u32 scale) {
+    if (m_frames_decoded == m_frame_count)
+        return false;
+
+    const auto pixels = m_width * m_height;
+    u32 position = 0;
+    while (position < pixels) {
+        if (m_data == m_end)
+            return false;
+
+        const auto token = *m_data++;
+        u32 count;
+        if (!(token & TOKEN_RUN)) {
+            if (!read_count(token & SKIP_COUNT_MAX, SKIP_COUNT_MAX, count) || count > pixels - position)
+                return false;
+            position += count;
+            continue;
+        }
+
+        if (!read_count(token & RUN_COUNT_MAX, RUN_COUNT_MAX, count) || count > pixels - position)
+            return false;
+
+        // 4-bit luma, spread over the full 8-bit range.
+        const auto luma = static_cast<u32>((token >> 3) & 0x0f) * 0x11;
+        const auto color = luma * 0x010101u;
+
+        // A run can wrap around into the following rows, each piece becomes one rectangle.
+        while (count > 0) {
+            const auto column = position % m_width;
+            const auto row = position / m_width;
+            const auto length = count < m_width - column ? count : m_width - column;
+            framebuffer.fill_rect({ x + column * scale, y + row * scale, length * scale, scale }, color);
+            position += length;
+            count -= length;
+        }
+    }
+
+    m_frames_decoded++;
+    return true;
+}
+
+}
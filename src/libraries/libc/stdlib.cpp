@@ -8,11 +8,14 @@ void* malloc(size_t size) {
 }
 
 void* calloc(size_t count, size_t size) {
-    return MM.allocate(count * size);
+    size_t total;
+    if (__builtin_mul_overflow(count, size, &total))
+        return nullptr;
+    return MM.allocate_zeroed(total);
 }
 
-void* realloc([[maybe_unused]] void* ptr, size_t size) {
-    return MM.allocate(size);
+void* realloc(void* ptr, size_t size) {
+    return MM.reallocate(ptr, size);
 }
 
 void* _aligned_malloc(size_t size, size_t alignment) {
@@ -24,7 +27,7 @@ void free(void* ptr) {
 }
 
 void _aligned_free(void* ptr) {
-    MM.free_aligned(ptr);
+    MM.free(ptr);
 }
 
 double atof(const char* str) {
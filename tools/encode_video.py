@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Encodes raw 8-bit grayscale frames into the delta-coded video format played by the kernel
+(see include/kernel/video/video_decoder.h for the format).
+
+The input is frames of width * height bytes back to back, like the original bad_apple.bin.
+Luma is quantized to 4 bits, and every frame is coded as skips over pixels that did not change since the
+previous frame and runs of a single luma value.
+
+Usage: tools/encode_video.py bad_apple.raw bad_apple.bin [--width 64] [--height 48]
+The output is linked into the kernel as before:
+    objcopy -I binary -O elf32-i386 -B i386 bad_apple.bin build/bad_apple.o
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"BAV1"
+SKIP_COUNT_MAX = 0x7F
+RUN_COUNT_MAX = 0x07
+
+
+def leb128(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def token(prefix, field_max, count):
+    """A token with a count field, extended with LEB128 when the count does not fit."""
+    if count - 1 < field_max:
+        return bytes([prefix | (count - 1)])
+    return bytes([prefix | field_max]) + leb128(count - 1 - field_max)
+
+
+def encode_frame(previous, current):
+    out = bytearray()
+    position = 0
+    pixels = len(current)
+    while position < pixels:
+        if current[position] == previous[position]:
+            end = position
+            while end < pixels and current[end] == previous[end]:
+                end += 1
+            out += token(0x00, SKIP_COUNT_MAX, end - position)
+        else:
+            # Unchanged pixels of the same value are cheaper to include in the run than to skip over.
+            value = current[position]
+            end = position
+            while end < pixels and current[end] == value:
+                end += 1
+            out += token(0x80 | (value << 3), RUN_COUNT_MAX, end - position)
+        position = end
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("--width", type=int, default=64)
+    parser.add_argument("--height", type=int, default=48)
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        raw = f.read()
+
+    frame_size = args.width * args.height
+    frame_count = len(raw) // frame_size
+    if frame_count == 0:
+        sys.exit("input holds no complete frame")
+
+    out = bytearray(MAGIC + struct.pack("<HHI", args.width, args.height, frame_count))
+    previous = bytes(frame_size)
+    for frame in range(frame_count):
+        data = raw[frame * frame_size:(frame + 1) * frame_size]
+        current = bytes((value * 15 + 127) // 255 for value in data)
+        out += encode_frame(previous, current)
+        previous = current
+
+    with open(args.output, "wb") as f:
+        f.write(out)
+
+    print(f"{frame_count} frames, {len(raw)} -> {len(out)} bytes ({len(raw) / len(out):.1f}x)")
+
+
+if __name__ == "__main__":
+    main()